@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <string.h>
+#include <uart.h>
+#include <printf.h>
+#include <crc.h>
+
+/* CRC benchmark: cycles taken by the bitwise, nibble table and byte
+ * table versions of the CRC update, measured with timer 1 running at
+ * the CPU clock. frames have the same size as a full radio433 frame */
+
+#define FRAME_SIZE	40
+
+struct crc_bench_s {
+	char *name;
+	uint16_t (*update)(uint16_t crc, uint8_t data);
+};
+
+struct crc_bench_s bench[] = {
+	{"bitwise", crc16ccitt_bit},
+	{"nibble ", crc16ccitt_nibble},
+	{"byte   ", crc16ccitt_byte}
+};
+
+static uint16_t null_update(uint16_t crc, uint8_t data)
+{
+	return crc;
+}
+
+static uint16_t run(uint16_t (*update)(uint16_t crc, uint8_t data), uint8_t *data, uint8_t len, uint16_t *crc)
+{
+	uint16_t start, stop;
+
+	*crc = 0xffff;
+	cli();
+	start = TCNT1;
+	while (len--)
+		*crc = update(*crc, *data++);
+	stop = TCNT1;
+	sei();
+
+	return stop - start;
+}
+
+int main(void){
+	uint8_t buf[FRAME_SIZE];
+	uint16_t overhead, cycles, crc, i;
+
+	for (i = 0; i < FRAME_SIZE; i++)
+		buf[i] = i * 7 + 3;
+
+	uart_init(57600);
+	uart_flush();
+
+	/* timer 1, normal mode, no prescaler */
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);
+
+	printf("crc16ccitt benchmark, %d byte frame\n", FRAME_SIZE);
+
+	while (1){
+		overhead = run(null_update, buf, FRAME_SIZE, &crc);
+		for (i = 0; i < sizeof(bench) / sizeof(struct crc_bench_s); i++) {
+			cycles = run(bench[i].update, buf, FRAME_SIZE, &crc) - overhead;
+			printf("%s: %d cycles/frame, %d cycles/byte, crc %x\n",
+				bench[i].name, cycles, cycles / FRAME_SIZE, crc);
+		}
+		printf("\n");
+		_delay_ms(2000);
+	}
+
+	return 0;
+}
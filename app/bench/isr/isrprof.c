@@ -0,0 +1,462 @@
+/* file:          isrprof.c
+ * description:   cycle level ISR profiler for the app images, runs a
+ *                firmware under simavr with a scripted RX pin waveform
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <gelf.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_irq.h>
+#include <sim_interrupts.h>
+#include <sim_cycle_timers.h>
+#include <avr_ioport.h>
+#include <avr_uart.h>
+
+/*
+simavr raises the PENDING irq of a vector when its flag is set and the
+RUNNING irq when the vector is taken (and drops it on reti). cycles of
+each ISR are counted from the vector jump to its reti, minus the cycles
+of ISRs nested in it (the radio dispatch runs with interrupts enabled).
+latency is the time from PENDING to RUNNING, charged to the ISR that was
+running when the flag was set (or to the main code, with interrupts
+disabled or not).
+
+for the radio timer vectors the FSM state is read from the radio data
+at the ISR entry: radios[] of radio433.c gives the address of the radio
+data and layout.o (built for the same MCU) the offset of the state.
+*/
+
+#define MAX_VECTORS		64
+#define MAX_NESTING		8
+#define MAX_EDGES		65536
+
+/* enum radio_state, states.h is generated from radio433.h */
+static const char *states[] = {
+#include "states.h"
+};
+
+#define MAX_STATES		(sizeof(states) / sizeof(states[0]))
+
+struct vector_s {
+	uint8_t timer;			// radio timer of this vector, plus one
+	uint32_t count;
+	uint64_t cycles;
+	uint32_t min;
+	uint32_t max;
+	uint64_t pending;		// cycle of the last PENDING
+	uint8_t blocker;		// vector running at PENDING (0 is main)
+	uint32_t latency[MAX_VECTORS];	// worst latency, by blocker
+	uint32_t state_count[MAX_STATES];
+	uint64_t state_cycles[MAX_STATES];
+	uint32_t state_min[MAX_STATES];
+	uint32_t state_max[MAX_STATES];
+};
+
+struct frame_s {
+	uint8_t vector;
+	uint8_t state;
+	uint64_t entry;
+	uint64_t nested;
+};
+
+struct edge_s {
+	uint64_t cycle;
+	uint8_t level;
+};
+
+struct isr_s {
+	uint8_t vector;
+	const char *name;
+};
+
+struct mcu_s {
+	const char *name;
+	uint8_t compa[3];		// radio timers 0, 1 and 2
+	struct isr_s isrs[8];		// other vectors of the libraries
+};
+
+/* vector numbers of the compare match (radio) ISRs, and of the radio
+ * word sync edge (RX_PCINT_vect, any of PCINT0..2), servo (TIMER0_OVF),
+ * UART RX and ISR load (PROF_ISR, timer 1 or 3 overflow) ISRs */
+static const struct mcu_s mcus[] = {
+	{ "atmega8",	{ 0, 6, 3 },	{ { 9, "servo" }, { 11, "uart rx" }, { 8, "prof" } } },
+	{ "atmega32",	{ 10, 7, 4 },	{ { 11, "servo" }, { 13, "uart rx" }, { 9, "prof" } } },
+	{ "atmega328p",	{ 14, 11, 7 },	{ { 3, "pcint0" }, { 4, "pcint1" }, { 5, "pcint2" },
+					{ 16, "servo" }, { 18, "uart rx" }, { 13, "prof" } } },
+	{ "atmega2560",	{ 21, 17, 13 },	{ { 9, "pcint0" }, { 10, "pcint1" }, { 11, "pcint2" },
+					{ 23, "servo" }, { 25, "uart rx" }, { 35, "prof" } } },
+	{ 0 }
+};
+
+static avr_t *avr;
+static const struct mcu_s *mcu;
+static struct vector_s vectors[MAX_VECTORS];
+static struct frame_s stack[MAX_NESTING];
+static uint8_t depth;
+static uint32_t radios, state_offset;
+static struct edge_s *edges;
+static uint32_t nedges, next_edge;
+static avr_irq_t *rx_irq;
+static FILE *record;
+static uint32_t uart_us;
+static uint8_t uart_byte;
+
+static void usage(char *name)
+{
+	printf("usage: %s [options] code.elf\n"
+		"  -m mcu         atmega8, atmega32, atmega328p or atmega2560 (atmega2560)\n"
+		"  -f hz          clock frequency (16000000)\n"
+		"  -t ms          simulated time (5000)\n"
+		"  -i file        RX pin waveform, lines of 'us level'\n"
+		"  -p pin         RX pin (C3)\n"
+		"  -o file        record the TX pin waveform to a file\n"
+		"  -P pin         TX pin (C2)\n"
+		"  -l layout.o    radio data layout, for the per state profile\n"
+		"  -u us          feed a byte to the UART every us, 0 for none (0)\n"
+		"  -c cycles      fail if a radio ISR takes longer, 0 for no limit (0)\n"
+		"  -v             show the firmware UART output\n", name);
+	exit(1);
+}
+
+static int elf_symbol(const char *file, const char *name, uint32_t *value, uint32_t *size)
+{
+	Elf *elf;
+	Elf_Scn *scn = 0;
+	Elf_Data *data;
+	GElf_Shdr shdr;
+	GElf_Sym sym;
+	uint32_t i;
+	int fd, found = 0;
+	
+	elf_version(EV_CURRENT);
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	
+	elf = elf_begin(fd, ELF_C_READ, 0);
+	while (elf && !found && (scn = elf_nextscn(elf, scn))) {
+		if (!gelf_getshdr(scn, &shdr) || shdr.sh_type != SHT_SYMTAB)
+			continue;
+		
+		data = elf_getdata(scn, 0);
+		for (i = 0; data && i < shdr.sh_size / shdr.sh_entsize; i++) {
+			if (!gelf_getsym(data, i, &sym))
+				continue;
+			if (!strcmp(elf_strptr(elf, shdr.sh_link, sym.st_name), name)) {
+				*value = sym.st_value;
+				*size = sym.st_size;
+				found = 1;
+				break;
+			}
+		}
+	}
+	if (elf)
+		elf_end(elf);
+	close(fd);
+	
+	return found;
+}
+
+static uint8_t radio_state(uint8_t timer)
+{
+	uint16_t radio;
+	
+	/* radios[timer], a pointer to the radio data (in SRAM) */
+	radio = avr->data[radios + timer * 2] | (avr->data[radios + timer * 2 + 1] << 8);
+	if (!radio)
+		return MAX_STATES;
+	
+	return avr->data[radio + state_offset];
+}
+
+static void isr_pending(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	struct vector_s *v = param;
+	
+	if (!value)
+		return;
+	
+	v->pending = avr->cycle;
+	v->blocker = depth ? stack[depth - 1].vector : 0;
+}
+
+static void isr_running(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	struct vector_s *v = param;
+	struct frame_s *frame;
+	uint32_t cycles, latency;
+	uint8_t num = v - vectors;
+	
+	if (value) {
+		latency = v->pending ? avr->cycle - v->pending : 0;
+		if (latency > v->latency[v->blocker])
+			v->latency[v->blocker] = latency;
+		v->pending = 0;
+		
+		if (depth == MAX_NESTING) {
+			fprintf(stderr, "isrprof: ISRs nested too deep\n");
+			exit(1);
+		}
+		frame = &stack[depth++];
+		frame->vector = num;
+		frame->state = v->timer && radios ? radio_state(v->timer - 1) : MAX_STATES;
+		frame->entry = avr->cycle;
+		frame->nested = 0;
+		
+		return;
+	}
+	
+	/* reti. the cycles of this ISR are nested cycles of the one below */
+	if (!depth)
+		return;
+	frame = &stack[--depth];
+	cycles = avr->cycle - frame->entry - frame->nested;
+	if (depth)
+		stack[depth - 1].nested += avr->cycle - frame->entry;
+	
+	v = &vectors[frame->vector];
+	if (!v->count || cycles < v->min)
+		v->min = cycles;
+	if (cycles > v->max)
+		v->max = cycles;
+	v->count++;
+	v->cycles += cycles;
+	
+	if (frame->state < MAX_STATES) {
+		if (!v->state_count[frame->state] || cycles < v->state_min[frame->state])
+			v->state_min[frame->state] = cycles;
+		if (cycles > v->state_max[frame->state])
+			v->state_max[frame->state] = cycles;
+		v->state_count[frame->state]++;
+		v->state_cycles[frame->state] += cycles;
+	}
+}
+
+static avr_cycle_count_t rx_edge(avr_t *core, avr_cycle_count_t when, void *param)
+{
+	/* drive the RX pin along the waveform */
+	while (next_edge < nedges && edges[next_edge].cycle <= when)
+		avr_raise_irq(rx_irq, edges[next_edge++].level);
+	
+	return next_edge < nedges ? edges[next_edge].cycle : 0;
+}
+
+static void tx_edge(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	static int level = -1;
+	
+	/* pin writes that keep the level are not edges */
+	if ((value ? 1 : 0) == level)
+		return;
+	level = value ? 1 : 0;
+	fprintf(record, "%.3f %d\n", avr->cycle * 1e6 / avr->frequency, level);
+}
+
+static avr_cycle_count_t uart_feed(avr_t *core, avr_cycle_count_t when, void *param)
+{
+	avr_raise_irq(avr_io_getirq(core, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT), uart_byte++);
+	
+	return when + avr_usec_to_cycles(core, uart_us);
+}
+
+static int parse_pin(const char *arg, char *port, uint8_t *pin)
+{
+	if (strlen(arg) != 2 || arg[0] < 'A' || arg[0] > 'L' || arg[1] < '0' || arg[1] > '7')
+		return 0;
+	*port = arg[0];
+	*pin = arg[1] - '0';
+	
+	return 1;
+}
+
+static void load_wave(const char *file)
+{
+	FILE *f;
+	double us;
+	int level;
+	
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		exit(1);
+	}
+	
+	edges = malloc(MAX_EDGES * sizeof(struct edge_s));
+	while (nedges < MAX_EDGES && fscanf(f, "%lf %d", &us, &level) == 2) {
+		edges[nedges].cycle = us * avr->frequency / 1e6;
+		edges[nedges].level = level ? 1 : 0;
+		nedges++;
+	}
+	fclose(f);
+}
+
+static const char *isr_name(uint8_t num)
+{
+	static char buf[4][16];
+	static uint8_t next;
+	const struct isr_s *isr;
+	char *name = buf[next++ % 4];
+	
+	if (vectors[num].timer) {
+		sprintf(name, "radio%d", vectors[num].timer - 1);
+		return name;
+	}
+	for (isr = mcu->isrs; isr->name; isr++)
+		if (isr->vector == num)
+			return isr->name;
+	sprintf(name, "vector %d", num);
+	
+	return name;
+}
+
+static void report(void)
+{
+	struct vector_s *v;
+	uint32_t i, j;
+	
+	printf("vector  isr            count      min      avg      max  worst latency (blocked by)\n");
+	for (i = 1; i < MAX_VECTORS; i++) {
+		v = &vectors[i];
+		if (!v->count)
+			continue;
+		
+		printf("%6d  %-10s %9u %8u %8llu %8u ", i, isr_name(i), v->count, v->min,
+			(unsigned long long)(v->cycles / v->count), v->max);
+		for (j = 0; j < MAX_VECTORS; j++)
+			if (v->latency[j])
+				printf(" %u (%s)", v->latency[j], j ? isr_name(j) : "main");
+		printf("\n");
+		
+		for (j = 0; j < MAX_STATES; j++) {
+			if (!v->state_count[j])
+				continue;
+			printf("        %-10s %9u %8u %8llu %8u\n", states[j],
+				v->state_count[j], v->state_min[j],
+				(unsigned long long)(v->state_cycles[j] / v->state_count[j]), v->state_max[j]);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t firmware;
+	avr_irq_t *irq;
+	const char *name = "atmega2560", *wave = 0, *layout = 0;
+	char rx_port = 'C', tx_port = 'C';
+	uint8_t rx_pin = 3, tx_pin = 2, verbose = 0;
+	uint32_t freq = 16000000, ms = 5000, limit = 0, flags = 0, size, i, t;
+	uint64_t end;
+	int opt, state, fail = 0;
+	
+	while ((opt = getopt(argc, argv, "m:f:t:i:p:o:P:l:u:c:v")) != -1) {
+		switch (opt) {
+		case 'm': name = optarg; break;
+		case 'f': freq = atol(optarg); break;
+		case 't': ms = atol(optarg); break;
+		case 'i': wave = optarg; break;
+		case 'p': if (!parse_pin(optarg, &rx_port, &rx_pin)) usage(argv[0]); break;
+		case 'o':
+			record = fopen(optarg, "w");
+			if (!record) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		case 'P': if (!parse_pin(optarg, &tx_port, &tx_pin)) usage(argv[0]); break;
+		case 'l': layout = optarg; break;
+		case 'u': uart_us = atol(optarg); break;
+		case 'c': limit = atol(optarg); break;
+		case 'v': verbose = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+	
+	for (mcu = mcus; mcu->name && strcmp(mcu->name, name); mcu++);
+	if (!mcu->name)
+		usage(argv[0]);
+	
+	if (elf_read_firmware(argv[optind], &firmware)) {
+		fprintf(stderr, "isrprof: can't load %s\n", argv[optind]);
+		return 1;
+	}
+	avr = avr_make_mcu_by_name(name);
+	if (!avr) {
+		fprintf(stderr, "isrprof: no simavr core for %s\n", name);
+		return 1;
+	}
+	avr_init(avr);
+	avr->frequency = freq;
+	avr_load_firmware(avr, &firmware);
+	
+	/* the firmware printf() goes nowhere, unless asked for */
+	if (!verbose)
+		avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+	
+	/* per state profile of the radio ISRs */
+	if (layout) {
+		if (!elf_symbol(argv[optind], "radios", &radios, &size) ||
+		    !elf_symbol(layout, "radio_state_offset", &state_offset, &size)) {
+			fprintf(stderr, "isrprof: no radios[] in %s or layout in %s\n", argv[optind], layout);
+			return 1;
+		}
+		/* data addresses are at 0x800000 in the ELF */
+		radios &= 0xffff;
+		state_offset = size - 1;
+	}
+	
+	for (t = 0; t < 3; t++)
+		if (mcu->compa[t])
+			vectors[mcu->compa[t]].timer = t + 1;
+	for (i = 1; i < MAX_VECTORS; i++) {
+		irq = avr_get_interrupt_irq(avr, i);
+		if (!irq)
+			continue;
+		avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, isr_pending, &vectors[i]);
+		avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, isr_running, &vectors[i]);
+	}
+	
+	if (wave) {
+		load_wave(wave);
+		rx_irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(rx_port), rx_pin);
+		if (nedges)
+			avr_cycle_timer_register(avr, edges[0].cycle, rx_edge, 0);
+	}
+	if (record)
+		avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(tx_port), tx_pin), tx_edge, 0);
+	if (uart_us)
+		avr_cycle_timer_register_usec(avr, uart_us, uart_feed, 0);
+	
+	end = (uint64_t)ms * freq / 1000;
+	do {
+		state = avr_run(avr);
+	} while (avr->cycle < end && state != cpu_Done && state != cpu_Crashed);
+	
+	if (record)
+		fclose(record);
+	if (state == cpu_Crashed) {
+		fprintf(stderr, "isrprof: firmware crashed at cycle %llu\n", (unsigned long long)avr->cycle);
+		return 1;
+	}
+	
+	printf("%s: %s at %u Hz, %u ms, %u RX edges\n", argv[optind], name, freq, ms, next_edge);
+	report();
+	
+	for (t = 0; t < 3; t++)
+		if (limit && mcu->compa[t] && vectors[mcu->compa[t]].max > limit) {
+			printf("radio%d ISR takes up to %u cycles, limit is %u\n", t, vectors[mcu->compa[t]].max, limit);
+			fail = 1;
+		}
+	
+	return fail;
+}
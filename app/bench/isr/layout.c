@@ -0,0 +1,9 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <radio433.h>
+
+/* built for the same MCU and options as the firmware, but not linked.
+ * isrprof takes the offset of the FSM state in the radio data from the
+ * size of this object (offset plus one) */
+const uint8_t radio_state_offset[offsetof(struct radio_data_s, state) + 1] = { 0 };
@@ -9,6 +9,7 @@
 
 int main(void){
 	struct radio_data_s radiorx;
+	struct radio_rxbuf_s rxbuf;
 	uint8_t buf[MAX_FRAME_SIZE];
 	int val, cnt = 0;
 	uint8_t payload;
@@ -18,7 +19,7 @@ int main(void){
 	
 	printf("ok\n");
 	
-	radio433_setup(&radiorx, 1000, RX);
+	radio433_setup(&radiorx, &rxbuf, 0, 1000, RX);
 
 	while (1){
 		/* is there any data? */
@@ -37,7 +38,8 @@ int main(void){
 				printf("FRAME ERROR\n");
 		}
 
-		/* wait before trying again.. */
-		_delay_ms(100);
+		/* ring is empty, wait before trying again.. */
+		if (val == ERR_NO_DATA)
+			_delay_ms(100);
 	}
 }
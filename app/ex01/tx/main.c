@@ -9,6 +9,7 @@
 
 int main(void){
 	struct radio_data_s radiotx;
+	struct radio_txbuf_s txbuf;
 	uint8_t buf[MAX_FRAME_SIZE];
 	uint8_t buf2[MAX_FRAME_SIZE];
 	uint8_t cnt = 0;
@@ -26,7 +27,7 @@ int main(void){
 
 	printf("ok\n");
 	
-	radio433_setup(&radiotx, 1000, TX);
+	radio433_setup(&radiotx, 0, &txbuf, 1000, TX);
 
 	while (1){
 		/* send a short message */
@@ -9,8 +9,10 @@
 
 int main(void){
 	struct radio_data_s radiorx;
+	struct radio_rxbuf_s rxbuf;
+	struct radio_stats_s stats;
 	uint8_t buf[MAX_DATA_SIZE];
-	int val, cnt = 0;
+	int val, cnt = 0, idle = 0;
 	uint8_t payload;
 	uint16_t src_addr;
 
@@ -19,7 +21,7 @@ int main(void){
 	
 	printf("ok\n");
 	
-	radio433_setup(&radiorx, 1000, RX);
+	radio433_setup(&radiorx, &rxbuf, 0, 1000, RX);
 	radio433_addr(&radiorx, 0x5150);
 
 	while (1){
@@ -41,7 +43,17 @@ int main(void){
 				printf("CRC ERROR\n");
 		}
 
-		/* wait before trying again.. */
-		_delay_ms(100);
+		/* ring is empty, wait before trying again.. */
+		if (val == ERR_NO_DATA)
+			_delay_ms(100);
+		
+		/* link statistics, every 10 seconds or so */
+		if (val == ERR_NO_DATA && ++idle == 100) {
+			idle = 0;
+			radio433_stats(&radiorx, &stats, 1);
+			printf("syncs %d frames %d length %d frame %d crc %d overruns %d filtered %d corrected %d\n",
+				stats.syncs, stats.frames, stats.length_errors, stats.frame_errors,
+				stats.crc_errors, stats.overruns, stats.filtered, stats.corrected);
+		}
 	}
 }
@@ -9,6 +9,7 @@
 
 int main(void){
 	struct radio_data_s radiotx;
+	struct radio_txbuf_s txbuf;
 	uint8_t buf[MAX_DATA_SIZE];
 	uint8_t buf2[MAX_DATA_SIZE];
 	uint8_t cnt = 0;
@@ -26,7 +27,7 @@ int main(void){
 
 	printf("ok\n");
 	
-	radio433_setup(&radiotx, 1000, TX);
+	radio433_setup(&radiotx, 0, &txbuf, 1000, TX);
 	radio433_addr(&radiotx, 0x5151);
 
 	while (1){
@@ -7,6 +7,8 @@
 #include <printf.h>
 #include <radio433.h>
 
+//#define HANDLER				// packets delivered by a handler (RADIO_CALLBACK)
+
 struct appdata_s {
 	int8_t ch1;
 	int8_t ch2;
@@ -16,8 +18,24 @@ struct appdata_s {
 	int8_t ch6;
 };
 
+#ifdef HANDLER
+static int cnt = 0;
+
+/* called at the end of the radio ISR (interrupts enabled) as soon as
+ * a packet for us arrives, instead of polling */
+void control_handler(struct radio_data_s *radio, uint16_t src_addr, uint8_t *data, uint8_t payload)
+{
+	struct appdata_s *const control = (struct appdata_s *)data;
+	
+	printf("%d: (%d bytes from %x) --> ch1: %d ch2: %d ch3: %d ch4: %d ch5: %d ch6: %d\n",
+	 cnt++, payload, src_addr, control->ch1, control->ch2,
+	 control->ch3, control->ch4, control->ch5, control->ch6);
+}
+#endif
+
 int main(void){
 	struct radio_data_s radiorx;
+	struct radio_rxbuf_s rxbuf;
 	uint8_t data[MAX_DATA_SIZE];
 	struct appdata_s *const control = (struct appdata_s *)data;
 	int val, cnt = 0;
@@ -29,9 +47,16 @@ int main(void){
 	
 	printf("ok\n");
 	
-	radio433_setup(&radiorx, 1000, RX);
+	radio433_setup(&radiorx, &rxbuf, 0, 1000, RX);
 	radio433_addr(&radiorx, 0x1234);
 	
+#ifdef HANDLER
+	radio433_handler(&radiorx, control_handler);
+	
+	/* the main loop is free for other work */
+	while (1);
+#endif
+	
 	while (1){
 		/* is there any data? */
 		val = radio433_recv(&radiorx, &src_addr, data, &payload);
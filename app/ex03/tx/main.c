@@ -6,6 +6,9 @@
 #include <uart.h>
 #include <printf.h>
 #include <radio433.h>
+#include <prof.h>
+
+//#define ISR_LOAD				// ISR load report (PROF_ISR in prof.h, timer 3)
 
 struct appdata_s {
 	int8_t ch1;
@@ -18,16 +21,23 @@ struct appdata_s {
 
 int main(void){
 	struct radio_data_s radiotx;
+	struct radio_txbuf_s txbuf;
 	uint8_t data[sizeof(struct appdata_s)];
 	struct appdata_s *const control = (struct appdata_s *)data;
+#ifdef ISR_LOAD
+	uint8_t reports = 0;
+#endif
 
 	uart_init(57600);
 	uart_flush();
 
 	printf("ok\n");
 	
-	radio433_setup(&radiotx, 1000, TX);
+	radio433_setup(&radiotx, 0, &txbuf, 1000, TX);
 	radio433_addr(&radiotx, 0x1234);
+#ifdef ISR_LOAD
+	prof_init();
+#endif
 	
 	memset(data, 0, sizeof(data));
 
@@ -45,5 +55,13 @@ int main(void){
 		
 		/* we are sending < 5 packets/s @ 1000bps*/
 		_delay_ms(300);
+		
+#ifdef ISR_LOAD
+		/* CPU time taken by the radio (and other) ISRs, every 5s or so */
+		if (++reports == 16) {
+			reports = 0;
+			prof_print();
+		}
+#endif
 	}
 }
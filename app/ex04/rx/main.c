@@ -6,10 +6,19 @@
 #include <uart.h>
 #include <printf.h>
 #include <radio433.h>
+#include <adc.h>
 #include <dc.h>
 
+//#define TELEMETRY				// half duplex telemetry downlink
+//#define LATENCY				// latency histograms (RADIO_STAMPS and RADIO_HIST)
+
+#ifdef TELEMETRY
+#define RADIO_RATE		2000		// control frame and telemetry slot fit in IDLE_MS
+#else
 #define RADIO_RATE		1000
+#endif
 #define RADIO_TIMEOUT		100
+#define BATTERY_CH		2		// battery voltage divider on ADC2
 //#define DEBUG
 
 struct appdata_s {
@@ -21,6 +30,12 @@ struct appdata_s {
 	uint8_t sum;		// simple checksum
 };
 
+struct telemetry_s {
+	uint16_t battery;	// battery voltage (raw ADC reading)
+	uint8_t quality;	// link quality (control frames received, out of the last 16)
+	uint8_t sum;		// simple checksum
+};
+
 
 uint8_t chksum(uint8_t *data, uint16_t size)
 {
@@ -32,6 +47,41 @@ uint8_t chksum(uint8_t *data, uint16_t size)
 	return ~(sum & 0xff);
 }
 
+uint8_t link_quality(int8_t seq)
+{
+	static uint16_t history = 0;
+	static int8_t last = 0;
+	uint8_t lost, i, quality = 0;
+	
+	/* ch4 is incremented for every control frame, so the ones
+	 * skipped in the sequence were lost */
+	lost = (uint8_t)(seq - last - 1);
+	last = seq;
+	
+	for (i = 0; i < lost && i < 16; i++)
+		history <<= 1;
+	history = (history << 1) | 1;
+	
+	for (i = 0; i < 16; i++)
+		if (history & (1 << i))
+			quality++;
+	
+	return quality;
+}
+
+#ifdef LATENCY
+void print_hist(char *name, uint16_t *bins)
+{
+	uint8_t i;
+	
+	/* frames in each bin: 0-1, 2-3, 4-7 ... bit periods */
+	printf("%s:", name);
+	for (i = 0; i < HIST_BINS; i++)
+		printf(" %d", bins[i]);
+	printf("\n");
+}
+#endif
+
 void init_ports()
 {
 	/* disable input pin interrupts */
@@ -41,12 +91,22 @@ void init_ports()
 
 int main(void){
 	struct radio_data_s radiorx;
+	struct radio_rxbuf_s rxbuf;
 	uint8_t data[MAX_DATA_SIZE];
 	struct appdata_s *const control = (struct appdata_s *)data;
+#ifdef TELEMETRY
+	struct radio_txbuf_s txbuf;
+	uint8_t reply[sizeof(struct telemetry_s)];
+	struct telemetry_s *const telemetry = (struct telemetry_s *)reply;
+#endif
 	int val;
 	uint8_t payload;
 	int16_t dc1, dc2;
 	uint16_t timeout = 0;
+#ifdef LATENCY
+	struct radio_hist_s hist;
+	uint16_t loops = 0;
+#endif
 
 	/* wait, so the MCU can be reprogrammed after a reset */
 	/* press reset and in less than 2s try to flash it */
@@ -63,7 +123,16 @@ int main(void){
 	dc_direction(1, STOP);
 	dc_direction(2, STOP);
 
-	radio433_setup(&radiorx, RADIO_RATE, RX);
+#ifdef TELEMETRY
+	radio433_setup(&radiorx, &rxbuf, &txbuf, RADIO_RATE, RX);
+#else
+	radio433_setup(&radiorx, &rxbuf, 0, RADIO_RATE, RX);
+#endif
+#ifdef TELEMETRY
+	/* half duplex, we turn around to TX only for the replies */
+	radio433_halfduplex(&radiorx, &TX_PORT, TX_PIN);
+	adc_init();
+#endif
 
 	while (1){
 		/* is there any data? */
@@ -83,6 +152,18 @@ int main(void){
 				continue;
 			}
 
+#ifdef TELEMETRY
+			/* the reply is armed for the next control frame, so the
+			 * FSM sends it in our slot right after that frame ends,
+			 * whenever this loop gets here. the readings are one
+			 * control frame old by then */
+			adc_set_channel(BATTERY_CH);
+			telemetry->battery = adc_read();
+			telemetry->quality = link_quality(control->ch4);
+			telemetry->sum = chksum(reply, sizeof(struct telemetry_s) - sizeof(uint8_t));
+			radio433_reply(&radiorx, reply, sizeof(struct telemetry_s));
+#endif
+
 			if (control->ch3 & 0x01) {
 				dc_direction(1, FORWARD);
 				dc_direction(2, FORWARD);
@@ -115,6 +196,18 @@ int main(void){
 			}
 		}
 
+#ifdef LATENCY
+		/* air time of control frames and the time they wait in the
+		 * RX ring for this loop, every 5s or so */
+		if (++loops == 500) {
+			loops = 0;
+			if (radio433_hist(&radiorx, &hist, 1) == ERR_OK) {
+				print_hist("air", hist.rxair);
+				print_hist("queue", hist.rxqueue);
+			}
+		}
+#endif
+
 		_delay_ms(10);
 	}
 }
@@ -9,7 +9,14 @@
 #include <adc.h>
 #include <dc.h>
 
+//#define TELEMETRY				// half duplex telemetry downlink
+//#define LATENCY				// latency histograms (RADIO_STAMPS and RADIO_HIST)
+
+#ifdef TELEMETRY
+#define RADIO_RATE		2000		// control frame and telemetry slot fit in IDLE_MS
+#else
 #define RADIO_RATE		1000
+#endif
 
 #define CTRL_DIR		DDRD
 #define CTRL_PORT		PORTD
@@ -34,6 +41,12 @@ struct appdata_s {
 	uint8_t sum;		// simple checksum
 };
 
+struct telemetry_s {
+	uint16_t battery;	// battery voltage (raw ADC reading)
+	uint8_t quality;	// link quality (control frames received, out of the last 16)
+	uint8_t sum;		// simple checksum
+};
+
 
 uint8_t chksum(uint8_t *data, uint16_t size)
 {
@@ -84,6 +97,19 @@ int8_t read_switches()
 	return val;
 }
 
+#ifdef LATENCY
+void print_hist(char *name, uint16_t *bins)
+{
+	uint8_t i;
+	
+	/* frames in each bin: 0-1, 2-3, 4-7 ... bit periods */
+	printf("%s:", name);
+	for (i = 0; i < HIST_BINS; i++)
+		printf(" %d", bins[i]);
+	printf("\n");
+}
+#endif
+
 void init_ports()
 {
 	/* switches are inputs */
@@ -100,8 +126,18 @@ void init_ports()
 int main(void)
 {
 	struct radio_data_s radiotx;
+	struct radio_txbuf_s txbuf;
 	uint8_t data[sizeof(struct appdata_s)];
 	struct appdata_s *const control = (struct appdata_s *)data;
+#ifdef TELEMETRY
+	struct radio_rxbuf_s rxbuf;
+	uint8_t reply[MAX_DATA_SIZE], payload;
+	struct telemetry_s *const telemetry = (struct telemetry_s *)reply;
+#endif
+#ifdef LATENCY
+	struct radio_hist_s hist;
+	uint8_t frames = 0;
+#endif
 	
 	/* wait, so the MCU can be reprogrammed after a reset */
 	/* press reset and in less than 2s try to flash it */
@@ -110,7 +146,19 @@ int main(void)
 	init_ports();
 	adc_init();
 	
-	radio433_setup(&radiotx, RADIO_RATE, TX);
+#if defined(TELEMETRY) || defined(LATENCY)
+	uart_init(57600);
+	uart_flush();
+#endif
+	
+#ifdef TELEMETRY
+	/* half duplex, the radio stays in RX and turns around to TX
+	 * whenever a control frame is queued */
+	radio433_setup(&radiotx, &rxbuf, &txbuf, RADIO_RATE, RX);
+	radio433_halfduplex(&radiotx, &TX_PORT, TX_PIN);
+#else
+	radio433_setup(&radiotx, 0, &txbuf, RADIO_RATE, TX);
+#endif
 	
 	memset(data, 0, sizeof(data));
 	control->ch4 = 0;
@@ -124,9 +172,30 @@ int main(void)
 		control->sum = chksum(data, sizeof(struct appdata_s) - sizeof(uint8_t));
 		
 		/* send a control message */
-		radio433_tx(&radiotx, data, sizeof(struct appdata_s));
+		radio433_txprio(&radiotx, data, sizeof(struct appdata_s), PRIO_HIGH);
 		
 		/* we are sending < 5 packets/s @ 1000bps*/
 		_delay_ms(IDLE_MS);
+		
+#ifdef TELEMETRY
+		/* the vehicle replies in the slot right after our control
+		 * frame (with readings taken after the previous one), so the
+		 * reply is here by now */
+		if (radio433_rx(&radiotx, reply, &payload) == ERR_OK &&
+		    payload == sizeof(struct telemetry_s) &&
+		    chksum(reply, sizeof(struct telemetry_s) - sizeof(uint8_t)) == telemetry->sum)
+			printf("battery: %d quality: %d\n", telemetry->battery, telemetry->quality);
+#endif
+#ifdef LATENCY
+		/* time control frames wait in the TX queue (behind the one
+		 * being sent) and their air time, every 32 frames */
+		if (++frames == 32) {
+			frames = 0;
+			if (radio433_hist(&radiotx, &hist, 1) == ERR_OK) {
+				print_hist("queue", hist.txqueue);
+				print_hist("air", hist.txair);
+			}
+		}
+#endif
 	}
 }
@@ -1 +1,7 @@
+#define CRC_TABLE		1			// 0: bitwise, 1: nibble table (32 bytes), 2: byte table (512 bytes) in flash
+
 uint16_t crc16ccitt(uint8_t *data, uint16_t len);
+uint16_t crc16ccitt_update(uint16_t crc, uint8_t data);
+uint16_t crc16ccitt_bit(uint16_t crc, uint8_t data);
+uint16_t crc16ccitt_nibble(uint16_t crc, uint8_t data);
+uint16_t crc16ccitt_byte(uint16_t crc, uint8_t data);
@@ -0,0 +1,175 @@
+/* file:          prof.c
+ * description:   ISR time accounting on a free running timer
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "printf.h"
+#include "prof.h"
+
+#if PROF_ISR == 1
+
+/*
+a 16 bit timer runs free at the CPU clock (no prescaler), and each
+instrumented ISR reads it at entry and exit. durations are taken modulo
+2^16 cycles, which is a lot more than any ISR takes. ISRs may nest (the
+radio dispatch runs with interrupts enabled), so each ISR adds its own
+time to prof_nested and the one it interrupted takes that out of its
+duration. the overflow interrupt of the timer counts time in 2^16 cycle
+steps, for the load of each ISR over the time elapsed.
+
+this timer can't be used for anything else. prof.h picks timer 3 when
+the MCU has one (ATmega2560, where it is free), or else timer 1, which
+the DC motor driver, servo1 and the radio (RADIO_TIMER1) check for.
+*/
+
+#if PROF_TIMER == 3
+#define PROF_TCCRA		TCCR3A
+#define PROF_TCCRB		TCCR3B
+#define PROF_TIMSK		TIMSK3
+#define PROF_TIFR		TIFR3
+#define PROF_TOV		TOV3
+#define PROF_TOIE		TOIE3
+#define PROF_CS			CS30
+#define PROF_OVF_vect		TIMER3_OVF_vect
+#else
+#define PROF_TCCRA		TCCR1A
+#define PROF_TCCRB		TCCR1B
+#ifndef ATMEGA8
+#define PROF_TIMSK		TIMSK1
+#define PROF_TIFR		TIFR1
+#else
+#define PROF_TIMSK		TIMSK
+#define PROF_TIFR		TIFR
+#endif
+#define PROF_TOV		TOV1
+#define PROF_TOIE		TOIE1
+#define PROF_CS			CS10
+#define PROF_OVF_vect		TIMER1_OVF_vect
+#endif
+
+volatile uint16_t prof_nested;
+static volatile struct prof_isr_s isrs[PROF_ISRS];
+static volatile uint16_t overflows;
+static uint32_t start;
+
+static const char *names[PROF_ISRS] = {
+	"radio0", "radio1", "radio2", "radio edge", "servo", "uart rx"
+};
+
+ISR(PROF_OVF_vect)
+{
+	overflows++;
+}
+
+static uint32_t prof_now(void)
+{
+	uint16_t count, ovf;
+	
+	/* with interrupts disabled. an overflow not counted yet (count
+	 * read right after it) is one more */
+	count = PROF_TCNT;
+	ovf = overflows;
+	if ((PROF_TIFR & (1 << PROF_TOV)) && count < 0x8000)
+		ovf++;
+	
+	return ((uint32_t)ovf << 16) | count;
+}
+
+void prof_account(uint8_t isr, uint16_t entry, uint16_t nest)
+{
+	uint16_t cycles;
+	
+	/* time in this ISR, less the ISRs nested in it */
+	cycles = (PROF_TCNT - entry) - (prof_nested - nest);
+	prof_nested += cycles;
+	
+	isrs[isr].cycles += cycles;
+	isrs[isr].count++;
+	if (cycles > isrs[isr].max)
+		isrs[isr].max = cycles;
+}
+
+void prof_init(void)
+{
+	uint8_t sreg;
+	
+	sreg = SREG;
+	cli();
+	PROF_TCCRA = 0;
+	PROF_TCCRB = (1 << PROF_CS);
+	PROF_TCNT = 0;
+	PROF_TIFR = (1 << PROF_TOV);
+	PROF_TIMSK |= (1 << PROF_TOIE);
+	overflows = 0;
+	prof_nested = 0;
+	start = 0;
+	memset((char *)isrs, 0, sizeof(isrs));
+	SREG = sreg;
+}
+
+void prof_read(struct prof_isr_s *isr, uint32_t *elapsed, uint8_t reset)
+{
+	uint8_t sreg;
+	uint32_t now;
+	
+	/* a snapshot of the counters (PROF_ISRS entries) and the cycles
+	 * elapsed since prof_init() or the last reset */
+	sreg = SREG;
+	cli();
+	now = prof_now();
+	memcpy(isr, (char *)isrs, sizeof(isrs));
+	*elapsed = now - start;
+	if (reset) {
+		memset((char *)isrs, 0, sizeof(isrs));
+		start = now;
+	}
+	SREG = sreg;
+}
+
+void prof_print(void)
+{
+	struct prof_isr_s isr[PROF_ISRS];
+	uint32_t elapsed, total = 0;
+	uint16_t load;
+	uint8_t i;
+	
+	/* load of each ISR (in 0.1%) since the last call */
+	prof_read(isr, &elapsed, 1);
+	elapsed = elapsed / 1000 + 1;
+	for (i = 0; i < PROF_ISRS; i++) {
+		if (!isr[i].count)
+			continue;
+		
+		load = isr[i].cycles / elapsed;
+		total += isr[i].cycles;
+		printf("%s: load %d.%d%% avg %d max %d cycles\n", names[i], load / 10, load % 10,
+			(uint16_t)(isr[i].cycles / isr[i].count), isr[i].max);
+	}
+	load = total / elapsed;
+	printf("isr load %d.%d%%, free %d.%d%%\n", load / 10, load % 10,
+		(1000 - load) / 10, (1000 - load) % 10);
+}
+
+#else
+
+void prof_init(void)
+{
+}
+
+void prof_read(struct prof_isr_s *isr, uint32_t *elapsed, uint8_t reset)
+{
+	memset(isr, 0, sizeof(struct prof_isr_s) * PROF_ISRS);
+	*elapsed = 0;
+}
+
+void prof_print(void)
+{
+}
+
+#endif
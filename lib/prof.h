@@ -0,0 +1,47 @@
+#define PROF_ISR		0			// ISR time accounting (radio, servo and UART ISRs)
+
+/* free running timer, picked from the MCU: timer 3 where there is one
+ * (ATmega2560), timer 1 elsewhere. timer 1 is also used by the DC motor
+ * driver, servo1 and RADIO_TIMER1, so they refuse to build with it */
+#ifdef TCNT3
+#define PROF_TIMER		3
+#else
+#define PROF_TIMER		1
+#endif
+
+#if PROF_ISR == 1 && PROF_TIMER == 1 && !defined(TCNT1)
+#error "PROF_ISR: no 16 bit timer for the profiler on this MCU"
+#endif
+
+enum prof_isr {
+	PROF_RADIO0, PROF_RADIO1, PROF_RADIO2, PROF_RADIO_EDGE, PROF_SERVO, PROF_UART_RX, PROF_ISRS
+};
+
+struct prof_isr_s {
+	uint32_t cycles;		// total, without nested ISRs
+	uint32_t count;
+	uint16_t max;
+};
+
+#if PROF_ISR == 1
+#if PROF_TIMER == 3
+#define PROF_TCNT		TCNT3
+#else
+#define PROF_TCNT		TCNT1
+#endif
+
+/* first and last thing in an instrumented ISR (PROF_EXIT() before each
+ * return too). the ISR prologue and epilogue are not accounted */
+#define PROF_ENTER()		uint16_t prof_entry = PROF_TCNT, prof_nest = prof_nested
+#define PROF_EXIT(isr)		prof_account(isr, prof_entry, prof_nest)
+
+extern volatile uint16_t prof_nested;
+void prof_account(uint8_t isr, uint16_t entry, uint16_t nest);
+#else
+#define PROF_ENTER()
+#define PROF_EXIT(isr)
+#endif
+
+void prof_init(void);
+void prof_read(struct prof_isr_s *isr, uint32_t *elapsed, uint8_t reset);
+void prof_print(void);
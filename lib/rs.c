@@ -0,0 +1,200 @@
+/* file:          rs.c
+ * description:   Reed-Solomon block code with erasure decoding
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "rs.h"
+
+/*
+Reed-Solomon over GF(256) (polynomial x^8 + x^4 + x^3 + x^2 + 1), with
+generator roots a^0 .. a^(nparity - 1). the code is shortened to the
+frame length and systematic: parity symbols are appended to the data.
+
+up to nparity erasures (symbols known to be bad, such as bytes with an
+invalid 4b5b symbol) or nparity / 2 errors (bad symbols in unknown
+places) are corrected, or any mix of both where 2 * errors + erasures
+<= nparity.
+
+like the CRC, field multiplication is done on the fly without log and
+antilog tables, so it costs no RAM. encoding and decoding are not done
+inside interrupt handlers, so this is fast enough.
+*/
+
+#define GF_POLY				0x1d
+#define GF_ALPHA_INV			0x8e
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+	uint8_t p = 0;
+
+	while (b) {
+		if (b & 1)
+			p ^= a;
+		if (a & 0x80)
+			a = (a << 1) ^ GF_POLY;
+		else
+			a <<= 1;
+		b >>= 1;
+	}
+
+	return p;
+}
+
+static uint8_t gf_inv(uint8_t a)
+{
+	uint8_t i, p = a;
+
+	/* a^254 = a^-1 */
+	for (i = 0; i < 6; i++)
+		p = gf_mul(gf_mul(p, p), a);
+
+	return gf_mul(p, p);
+}
+
+static uint8_t gf_pow2(uint8_t e)
+{
+	uint8_t p = 1;
+
+	while (e--)
+		p = gf_mul(p, 2);
+
+	return p;
+}
+
+static uint8_t gf_eval(uint8_t *poly, uint8_t len, uint8_t x)
+{
+	uint8_t y = 0;
+
+	/* coefficients in increasing order of degree (Horner) */
+	while (len--)
+		y = gf_mul(y, x) ^ poly[len];
+
+	return y;
+}
+
+void rs_encode(uint8_t *data, uint8_t len, uint8_t nparity)
+{
+	uint8_t gen[RS_MAX_PARITY + 1], *parity = data + len;
+	uint8_t i, j, root, fb;
+
+	if (nparity > RS_MAX_PARITY)
+		nparity = RS_MAX_PARITY;
+
+	/* generator polynomial, highest degree first (gen[0] = 1) */
+	memset(gen, 0, sizeof(gen));
+	gen[0] = 1;
+	for (i = 0, root = 1; i < nparity; i++, root = gf_mul(root, 2))
+		for (j = i + 1; j > 0; j--)
+			gen[j] ^= gf_mul(gen[j - 1], root);
+
+	/* parity is the remainder of data(x) * x^nparity / gen(x) */
+	memset(parity, 0, nparity);
+	for (i = 0; i < len; i++) {
+		fb = data[i] ^ parity[0];
+		for (j = 0; j < nparity - 1; j++)
+			parity[j] = parity[j + 1] ^ gf_mul(gen[j + 1], fb);
+		parity[nparity - 1] = gf_mul(gen[nparity], fb);
+	}
+}
+
+int rs_decode(uint8_t *data, uint8_t len, uint8_t nparity, uint8_t *erasure, uint8_t nerasures)
+{
+	uint8_t synd[RS_MAX_PARITY], lambda[RS_MAX_PARITY + 1];
+	uint8_t prev[RS_MAX_PARITY + 1], tmp[RS_MAX_PARITY + 1];
+	uint8_t omega[RS_MAX_PARITY], dlambda[RS_MAX_PARITY];
+	uint8_t i, j, r, x, xinv, deg, roots, errors = 0;
+	uint8_t delta, num, den;
+
+	if (nparity > RS_MAX_PARITY || nerasures > nparity || len <= nparity)
+		return -1;
+
+	/* syndromes, the codeword evaluated at the generator roots. data[0]
+	 * is the highest degree coefficient */
+	for (i = 0, x = 1; i < nparity; i++, x = gf_mul(x, 2)) {
+		synd[i] = 0;
+		for (j = 0; j < len; j++)
+			synd[i] = gf_mul(synd[i], x) ^ data[j];
+		errors |= synd[i];
+	}
+
+	/* no errors, erasures were good after all */
+	if (!errors)
+		return 0;
+
+	/* erasure locator: product of (1 - X x), X = a^(len - 1 - pos) */
+	memset(lambda, 0, sizeof(lambda));
+	lambda[0] = 1;
+	for (i = 0; i < nerasures; i++) {
+		if (erasure[i] >= len)
+			return -1;
+		x = gf_pow2(len - 1 - erasure[i]);
+		for (j = i + 1; j > 0; j--)
+			lambda[j] ^= gf_mul(lambda[j - 1], x);
+	}
+	memcpy(prev, lambda, sizeof(lambda));
+
+	/* Berlekamp-Massey, starting from the erasure locator, finds the
+	 * errors and erasures locator polynomial */
+	deg = nerasures;
+	for (r = nerasures; r < nparity; r++) {
+		delta = 0;
+		for (j = 0; j <= r; j++)
+			delta ^= gf_mul(lambda[j], synd[r - j]);
+
+		/* prev = x * prev */
+		memmove(prev + 1, prev, RS_MAX_PARITY);
+		prev[0] = 0;
+
+		if (!delta)
+			continue;
+
+		for (j = 0; j <= RS_MAX_PARITY; j++)
+			tmp[j] = lambda[j] ^ gf_mul(delta, prev[j]);
+
+		if (2 * deg <= r + nerasures) {
+			deg = r + 1 + nerasures - deg;
+			x = gf_inv(delta);
+			for (j = 0; j <= RS_MAX_PARITY; j++)
+				prev[j] = gf_mul(lambda[j], x);
+		}
+		memcpy(lambda, tmp, sizeof(lambda));
+	}
+
+	if (deg > nparity)
+		return -1;
+
+	/* error evaluator omega = synd * lambda mod x^nparity and the
+	 * formal derivative of lambda (odd powers only) */
+	for (i = 0; i < nparity; i++) {
+		omega[i] = 0;
+		for (j = 0; j <= i; j++)
+			omega[i] ^= gf_mul(synd[j], lambda[i - j]);
+		dlambda[i] = (i & 1) ? 0 : lambda[i + 1];
+	}
+
+	/* Chien search for the error locations (lambda(X^-1) = 0) and
+	 * Forney for the error values, from the last symbol to the first */
+	roots = 0;
+	for (i = len, x = 1, xinv = 1; i > 0; i--, x = gf_mul(x, 2), xinv = gf_mul(xinv, GF_ALPHA_INV)) {
+		if (gf_eval(lambda, deg + 1, xinv))
+			continue;
+
+		num = gf_mul(x, gf_eval(omega, nparity, xinv));
+		den = gf_eval(dlambda, nparity, xinv);
+		if (!den)
+			return -1;
+		data[i - 1] ^= gf_mul(num, gf_inv(den));
+		roots++;
+	}
+
+	/* the locator must have as many roots as its degree inside the
+	 * frame, otherwise there are too many errors */
+	if (roots != deg)
+		return -1;
+
+	return roots;
+}
@@ -0,0 +1,4 @@
+#define RS_MAX_PARITY		16			// parity symbols supported by the decoder
+
+void rs_encode(uint8_t *data, uint8_t len, uint8_t nparity);
+int rs_decode(uint8_t *data, uint8_t len, uint8_t nparity, uint8_t *erasure, uint8_t nerasures);
@@ -10,6 +10,7 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include "uart.h"
+#include "prof.h"
 
 
 #define RX_BUFFER_SIZE		32
@@ -98,6 +99,7 @@ ISR(USART_RXC_vect)
 #endif
 {
 	uint16_t tail;
+	PROF_ENTER();
 
 #ifndef ATMEGA8
 	while ((UCSR0A & (1 << RXC0)) != 0) {
@@ -118,4 +120,5 @@ ISR(USART_RXC_vect)
 			uart_p->rx_errors++;
 		}
 	}
+	PROF_EXIT(PROF_UART_RX);
 }
@@ -10,6 +10,11 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include <dc.h>
+#include <prof.h>
+
+#if PROF_ISR == 1 && PROF_TIMER == 1 && !defined(ALT_DC_CONFIG)
+#error "PROF_ISR: the profiler timer (timer 1) is the DC motor PWM timer, use ALT_DC_CONFIG or an ATmega2560"
+#endif
 
 long map(long x, long in_min, long in_max, long out_min, long out_max)
 {
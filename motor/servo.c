@@ -10,6 +10,11 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include <servo.h>
+#include <prof.h>
+
+#if PROF_ISR == 1 && PROF_TIMER == 1
+#error "PROF_ISR: the profiler timer (timer 1) is the servo1 timer, use an ATmega2560"
+#endif
 
 
 /* servo / ESC control using timer0, 8 channels */
@@ -21,8 +26,11 @@ static uint8_t channels = 0;
 
 ISR(TIMER0_OVF_vect)
 {
+	PROF_ENTER();
+	
 	if (++isr_count == servos[channel].count) {
 		TCNT0 = servos[channel].countdown;
+		PROF_EXIT(PROF_SERVO);
 		
 		return;
 	}
@@ -43,6 +51,7 @@ ISR(TIMER0_OVF_vect)
 				channel = 0;
 		}
 	}
+	PROF_EXIT(PROF_SERVO);
 }
 
 void servo0_init()
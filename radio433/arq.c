@@ -0,0 +1,210 @@
+/* file:          arq.c
+ * description:   selective repeat ARQ (reliable transport) on top of
+ *                radio433 packets
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include <radio433.h>
+#include <arq.h>
+
+#if RADIO_ARQ == 1
+
+/*
+each data frame carries a sequence number in the transport header and
+is acknowledged on its own by the receiver. the sender keeps up to
+ARQ_WINDOW frames in flight and retransmits only the ones not ACKed in
+ARQ_TIMEOUT bit periods. the receiver buffers frames that arrive out of
+order inside its window and delivers them in sequence, ACKing (again)
+and dropping duplicates.
+
+frames not ACKed after ARQ_RETRIES retransmissions are given up (drops)
+and the send window moves on. data frames carry the distance from their
+sequence number to the base of the send window, so the receiver knows
+which frames will never come, skips them (lost) and goes on delivering.
+the receiver compares sequence numbers modulo 256, so a link down for
+more than 127 given up frames must be restarted on both ends.
+
+tx and rx may be the same half duplex radio or two radio instances.
+*/
+
+static int radio433_arq_xmit(struct radio_arq_s *arq, uint8_t seq)
+{
+	struct arq_frame_s *frame = &arq->txwin[seq % ARQ_WINDOW];
+	struct transport_s hdr;
+	
+	hdr.dst_addr = arq->peer;
+	hdr.seq = seq;
+	hdr.flags = ARQ_DATA | (uint8_t)(seq - arq->txbase) << ARQ_BASE;
+	
+	/* the TX queue may be full, we will try again later */
+	if (radio433_sendpkt(arq->tx, &hdr, frame->data, frame->payload, PRIO_LOW) != ERR_OK)
+		return ERR_BUSY;
+	
+	/* the retransmit timer starts when the frame is queued */
+	frame->state = ARQ_SENT;
+	frame->time = radio433_ticks(arq->rx);
+	
+	return ERR_OK;
+}
+
+static void radio433_arq_ack(struct radio_arq_s *arq, uint8_t seq)
+{
+	struct transport_s hdr;
+	
+	/* ACKs are short control frames, send them first. if lost, the
+	 * data frame is retransmitted and ACKed again */
+	hdr.dst_addr = arq->peer;
+	hdr.seq = seq;
+	hdr.flags = ARQ_ACK;
+	radio433_sendpkt(arq->tx, &hdr, 0, 0, PRIO_HIGH);
+}
+
+static void radio433_arq_skip(struct radio_arq_s *arq)
+{
+	/* frames before the send window of our peer were given up, stop
+	 * waiting for the ones we don't have */
+	while ((int8_t)(arq->peerbase - arq->rxbase) > 0 && arq->rxwin[arq->rxbase % ARQ_WINDOW].state == ARQ_FREE) {
+		arq->rxbase++;
+		arq->lost++;
+	}
+}
+
+int radio433_arq_init(struct radio_arq_s *arq, struct radio_data_s *tx, struct radio_data_s *rx, uint16_t peer)
+{
+	if (!tx->address || !rx->address)
+		return ERR_CONFIG;
+	
+	memset(arq, 0, sizeof(struct radio_arq_s));
+	arq->tx = tx;
+	arq->rx = rx;
+	arq->peer = peer;
+	
+	return ERR_OK;
+}
+
+int radio433_arq_send(struct radio_arq_s *arq, uint8_t *data, uint8_t payload)
+{
+	struct arq_frame_s *frame;
+	
+	/* send window is full, we should wait */
+	if ((uint8_t)(arq->txnext - arq->txbase) >= ARQ_WINDOW)
+		return ERR_BUSY;
+	
+	if (payload > MAX_DATA_SIZE)
+		payload = MAX_DATA_SIZE;
+	
+	frame = &arq->txwin[arq->txnext % ARQ_WINDOW];
+	memcpy(frame->data, data, payload);
+	frame->payload = payload;
+	frame->state = ARQ_QUEUED;
+	frame->retries = 0;
+	radio433_arq_xmit(arq, arq->txnext);
+	arq->txnext++;
+	
+	return ERR_OK;
+}
+
+int radio433_arq_recv(struct radio_arq_s *arq, uint8_t *data, uint8_t *payload)
+{
+	struct arq_frame_s *frame;
+	
+	radio433_arq_poll(arq);
+	
+	/* deliver frames in sequence only */
+	frame = &arq->rxwin[arq->rxbase % ARQ_WINDOW];
+	if (frame->state == ARQ_FREE)
+		return ERR_NO_DATA;
+	
+	memcpy(data, frame->data, frame->payload);
+	*payload = frame->payload;
+	frame->state = ARQ_FREE;
+	arq->rxbase++;
+	radio433_arq_skip(arq);
+	
+	return ERR_OK;
+}
+
+int radio433_arq_poll(struct radio_arq_s *arq)
+{
+	struct arq_frame_s *frame;
+	struct transport_s hdr;
+	uint8_t buf[MAX_DATA_SIZE], size, seq, base;
+	int rval;
+	
+	/* process incoming data frames and ACKs from our peer (none while
+	 * an RX slot is lent, radio433_acquire()) */
+	while (1) {
+		rval = radio433_recvpkt(arq->rx, &hdr, buf, &size);
+		if (rval == ERR_NO_DATA || rval == ERR_CONFIG || rval == ERR_BUSY)
+			break;
+		
+		if (rval != ERR_OK || hdr.src_addr != arq->peer)
+			continue;
+		
+		if (hdr.flags & ARQ_ACK) {
+			/* ACK inside the send window, release the frame */
+			if ((uint8_t)(hdr.seq - arq->txbase) < (uint8_t)(arq->txnext - arq->txbase))
+				arq->txwin[hdr.seq % ARQ_WINDOW].state = ARQ_FREE;
+		}
+		
+		if (hdr.flags & ARQ_DATA) {
+			base = hdr.seq - (hdr.flags >> ARQ_BASE);
+			if ((int8_t)(base - arq->peerbase) > 0) {
+				arq->peerbase = base;
+				radio433_arq_skip(arq);
+			}
+			
+			/* ACK anything inside the receive window or the one
+			 * before it (duplicates, our ACK was lost) */
+			if ((uint8_t)(hdr.seq - arq->rxbase) < ARQ_WINDOW) {
+				frame = &arq->rxwin[hdr.seq % ARQ_WINDOW];
+				if (frame->state == ARQ_FREE) {
+					memcpy(frame->data, buf, size);
+					frame->payload = size;
+					frame->state = ARQ_RECEIVED;
+				}
+				radio433_arq_ack(arq, hdr.seq);
+			} else if ((uint8_t)(arq->rxbase - hdr.seq) <= ARQ_WINDOW) {
+				radio433_arq_ack(arq, hdr.seq);
+			}
+		}
+	}
+	
+	/* slide the send window over ACKed frames */
+	while (arq->txbase != arq->txnext && arq->txwin[arq->txbase % ARQ_WINDOW].state == ARQ_FREE)
+		arq->txbase++;
+	
+	/* (re)transmit frames not queued yet or not ACKed in time */
+	for (seq = arq->txbase; seq != arq->txnext; seq++) {
+		frame = &arq->txwin[seq % ARQ_WINDOW];
+		
+		if (frame->state == ARQ_QUEUED) {
+			radio433_arq_xmit(arq, seq);
+		} else if (frame->state == ARQ_SENT &&
+		    (uint16_t)(radio433_ticks(arq->rx) - frame->time) >= ARQ_TIMEOUT) {
+			if (frame->retries++ < ARQ_RETRIES) {
+				frame->state = ARQ_QUEUED;
+				if (radio433_arq_xmit(arq, seq) == ERR_OK)
+					arq->retransmits++;
+			} else {
+				/* give up on this frame */
+				frame->state = ARQ_FREE;
+				arq->drops++;
+			}
+		}
+	}
+	
+	while (arq->txbase != arq->txnext && arq->txwin[arq->txbase % ARQ_WINDOW].state == ARQ_FREE)
+		arq->txbase++;
+	
+	/* frames still in flight */
+	return (uint8_t)(arq->txnext - arq->txbase);
+}
+
+#endif
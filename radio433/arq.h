@@ -0,0 +1,43 @@
+#define ARQ_WINDOW		4			// frames in flight (send and receive windows)
+#define ARQ_TIMEOUT		2000			// retransmit timeout (bit periods)
+#define ARQ_RETRIES		5			// retransmissions before a frame is dropped
+
+#define ARQ_DATA		0x01			// transport header flags
+#define ARQ_ACK			0x02
+#define ARQ_BASE		2			// data frames: seq minus the send window base, in the flags above this bit
+
+#if ARQ_WINDOW > (256 >> ARQ_BASE)
+#error "ARQ_WINDOW too large for the window base in the transport header"
+#endif
+
+enum arq_state {
+	ARQ_FREE, ARQ_QUEUED, ARQ_SENT, ARQ_RECEIVED
+};
+
+struct arq_frame_s {
+	uint8_t data[MAX_DATA_SIZE];
+	uint8_t payload;
+	uint8_t state;
+	uint8_t retries;
+	uint16_t time;
+};
+
+struct radio_arq_s {
+	struct radio_data_s *tx;
+	struct radio_data_s *rx;
+	uint16_t peer;
+	struct arq_frame_s txwin[ARQ_WINDOW];
+	struct arq_frame_s rxwin[ARQ_WINDOW];
+	uint8_t txbase;
+	uint8_t txnext;
+	uint8_t rxbase;
+	uint8_t peerbase;
+	uint16_t retransmits;
+	uint16_t drops;
+	uint16_t lost;
+};
+
+int radio433_arq_init(struct radio_arq_s *arq, struct radio_data_s *tx, struct radio_data_s *rx, uint16_t peer);
+int radio433_arq_send(struct radio_arq_s *arq, uint8_t *data, uint8_t payload);
+int radio433_arq_recv(struct radio_arq_s *arq, uint8_t *data, uint8_t *payload);
+int radio433_arq_poll(struct radio_arq_s *arq);
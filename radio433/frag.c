@@ -0,0 +1,242 @@
+/* file:          frag.c
+ * description:   fragmentation and reassembly of messages larger than
+ *                a radio433 packet
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include <radio433.h>
+#include <arq.h>
+#include <frag.h>
+
+#if RADIO_FRAG == 1
+
+/*
+a message of up to FRAG_MAX_SIZE bytes is split in fragments of up to
+FRAG_DATA_SIZE bytes, each one sent as a packet to our peer with a small
+header: message id, fragment index and fragment count. all fragments but
+the last one are full, so the receiver puts each fragment in place in
+the caller buffer as it arrives, in any order, and knows the message
+size when the last one shows up.
+
+a message is incomplete if no fragment arrives in FRAG_TIMEOUT bit
+periods or if a fragment of the next message arrives first. fragments
+may be sent as plain packets (lost fragments are reported) or through
+the ARQ (lost fragments are retransmitted).
+*/
+
+static int radio433_frag_xmit(struct radio_frag_s *frag, uint8_t *data, uint8_t payload)
+{
+#if RADIO_ARQ == 1
+	if (frag->arq)
+		return radio433_arq_send(frag->arq, data, payload);
+#endif
+	return radio433_send(frag->tx, frag->peer, data, payload);
+}
+
+static int radio433_frag_get(struct radio_frag_s *frag, uint8_t *data, uint8_t *payload)
+{
+	uint16_t src_addr;
+	int rval;
+	
+#if RADIO_ARQ == 1
+	if (frag->arq)
+		return radio433_arq_recv(frag->arq, data, payload);
+#endif
+	rval = radio433_recv(frag->rx, &src_addr, data, payload);
+	if (rval == ERR_OK && src_addr != frag->peer)
+		return ERR_FRAME_ERROR;
+	
+	return rval;
+}
+
+static int radio433_frag_store(struct radio_frag_s *frag, uint8_t *buf, uint8_t *data, uint8_t payload)
+{
+	uint8_t index, frags, size;
+	
+	index = data[1];
+	frags = data[2];
+	size = payload - FRAG_HEADER_SIZE;
+	
+	/* messages too large for us, or not fragments at all. the last
+	 * fragment of FRAG_MAX_FRAGS may still run past the buffer */
+	if (!frags || frags > FRAG_MAX_FRAGS || index >= frags)
+		return 0;
+	if (index != frags - 1 && size != FRAG_DATA_SIZE)
+		return 0;
+	if ((uint16_t)index * FRAG_DATA_SIZE + size > FRAG_MAX_SIZE)
+		return 0;
+	
+	/* first fragment of a message (in any order) */
+	if (frag->rxstate == FRAG_IDLE) {
+		frag->rxstate = FRAG_ASSEMBLY;
+		frag->rxid = data[0];
+		frag->rxfrags = frags;
+		frag->rxcount = 0;
+		memset(frag->rxmap, 0, sizeof(frag->rxmap));
+	}
+	
+	if (frags != frag->rxfrags)
+		return 0;
+	
+	frag->rxtime = radio433_ticks(frag->rx);
+	
+	/* duplicate */
+	if (frag->rxmap[index >> 3] & (1 << (index & 7)))
+		return 0;
+	
+	frag->rxmap[index >> 3] |= (1 << (index & 7));
+	memcpy(buf + (uint16_t)index * FRAG_DATA_SIZE, data + FRAG_HEADER_SIZE, size);
+	if (index == frags - 1)
+		frag->rxsize = (uint16_t)index * FRAG_DATA_SIZE + size;
+	
+	return ++frag->rxcount == frag->rxfrags;
+}
+
+static int radio433_frag_drop(struct radio_frag_s *frag, uint16_t *size)
+{
+	uint8_t i;
+	
+	/* report the part of the message received without holes */
+	for (i = 0; i < frag->rxfrags; i++)
+		if (!(frag->rxmap[i >> 3] & (1 << (i & 7))))
+			break;
+	
+	*size = (uint16_t)i * FRAG_DATA_SIZE;
+	frag->rxstate = FRAG_IDLE;
+	frag->incomplete++;
+	
+	return ERR_INCOMPLETE;
+}
+
+int radio433_frag_init(struct radio_frag_s *frag, struct radio_data_s *tx, struct radio_data_s *rx, uint16_t peer)
+{
+	if (!tx->address || !rx->address)
+		return ERR_CONFIG;
+	
+	memset(frag, 0, sizeof(struct radio_frag_s));
+	frag->tx = tx;
+	frag->rx = rx;
+	frag->peer = peer;
+	
+	return ERR_OK;
+}
+
+#if RADIO_ARQ == 1
+int radio433_frag_arq(struct radio_frag_s *frag, struct radio_arq_s *arq)
+{
+	if (arq->peer != frag->peer)
+		return ERR_CONFIG;
+	
+	frag->arq = arq;
+	
+	return ERR_OK;
+}
+#endif
+
+int radio433_frag_send(struct radio_frag_s *frag, uint8_t *data, uint16_t size)
+{
+	/* the last message is still being sent */
+	if (frag->txindex != frag->txcount)
+		return ERR_BUSY;
+	
+	if (!size || size > FRAG_MAX_SIZE)
+		return ERR_CONFIG;
+	
+	/* data is not copied, so it must be kept until sent (poll) */
+	frag->txdata = data;
+	frag->txsize = size;
+	frag->txid++;
+	frag->txindex = 0;
+	frag->txcount = (size + FRAG_DATA_SIZE - 1) / FRAG_DATA_SIZE;
+	radio433_frag_poll(frag);
+	
+	return ERR_OK;
+}
+
+int radio433_frag_recv(struct radio_frag_s *frag, uint8_t *buf, uint16_t *size)
+{
+	uint8_t data[MAX_DATA_SIZE], payload;
+	int rval;
+	
+	/* a fragment of a new message ended the last one, start with it */
+	if (frag->pendsize) {
+		payload = frag->pendsize;
+		frag->pendsize = 0;
+		if (radio433_frag_store(frag, buf, frag->pending, payload)) {
+			frag->rxstate = FRAG_IDLE;
+			*size = frag->rxsize;
+			
+			return ERR_OK;
+		}
+	}
+	
+	while (1) {
+		rval = radio433_frag_get(frag, data, &payload);
+		if (rval == ERR_NO_DATA || rval == ERR_CONFIG || rval == ERR_BUSY)
+			break;
+		
+		if (rval != ERR_OK || payload < FRAG_HEADER_SIZE)
+			continue;
+		
+		/* the rest of the last message was lost. keep this fragment
+		 * for the next call, as buf holds what we have of the last one */
+		if (frag->rxstate == FRAG_ASSEMBLY && data[0] != frag->rxid) {
+			memcpy(frag->pending, data, payload);
+			frag->pendsize = payload;
+			
+			return radio433_frag_drop(frag, size);
+		}
+		
+		if (radio433_frag_store(frag, buf, data, payload)) {
+			frag->rxstate = FRAG_IDLE;
+			*size = frag->rxsize;
+			
+			return ERR_OK;
+		}
+	}
+	
+	if (frag->rxstate == FRAG_ASSEMBLY &&
+	    (uint16_t)(radio433_ticks(frag->rx) - frag->rxtime) >= FRAG_TIMEOUT)
+		return radio433_frag_drop(frag, size);
+	
+	return ERR_NO_DATA;
+}
+
+int radio433_frag_poll(struct radio_frag_s *frag)
+{
+	uint8_t data[MAX_DATA_SIZE], payload;
+	uint16_t offset;
+	int left;
+	
+	/* queue as many fragments as the TX queue (or ARQ window) takes */
+	while (frag->txindex != frag->txcount) {
+		offset = (uint16_t)frag->txindex * FRAG_DATA_SIZE;
+		payload = frag->txsize - offset > FRAG_DATA_SIZE ? FRAG_DATA_SIZE : frag->txsize - offset;
+		
+		data[0] = frag->txid;
+		data[1] = frag->txindex;
+		data[2] = frag->txcount;
+		memcpy(data + FRAG_HEADER_SIZE, frag->txdata + offset, payload);
+		if (radio433_frag_xmit(frag, data, payload + FRAG_HEADER_SIZE) != ERR_OK)
+			break;
+		
+		frag->txindex++;
+	}
+	
+	/* fragments not sent yet (and not ACKed yet, over the ARQ) */
+	left = frag->txcount - frag->txindex;
+#if RADIO_ARQ == 1
+	if (frag->arq)
+		left += radio433_arq_poll(frag->arq);
+#endif
+	
+	return left;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#define FRAG_MAX_SIZE		512			// largest message (bytes)
+#define FRAG_TIMEOUT		12000			// reassembly timeout since the last fragment (bit periods)
+
+#define FRAG_HEADER_SIZE	3			// message id, fragment index and fragment count
+#define FRAG_DATA_SIZE		(MAX_DATA_SIZE - FRAG_HEADER_SIZE)
+#define FRAG_MAX_FRAGS		((FRAG_MAX_SIZE + FRAG_DATA_SIZE - 1) / FRAG_DATA_SIZE)
+
+enum frag_state {
+	FRAG_IDLE, FRAG_ASSEMBLY, FRAG_PENDING
+};
+
+struct radio_frag_s {
+	struct radio_data_s *tx;
+	struct radio_data_s *rx;
+	uint16_t peer;
+#if RADIO_ARQ == 1
+	struct radio_arq_s *arq;
+#endif
+	uint8_t *txdata;
+	uint16_t txsize;
+	uint8_t txid;
+	uint8_t txindex;
+	uint8_t txcount;
+	uint8_t rxstate;
+	uint8_t rxid;
+	uint8_t rxcount;
+	uint8_t rxfrags;
+	uint16_t rxsize;
+	uint16_t rxtime;
+	uint8_t rxmap[(FRAG_MAX_FRAGS + 7) / 8];
+	uint8_t pending[MAX_DATA_SIZE];
+	uint8_t pendsize;
+	uint16_t incomplete;
+};
+
+int radio433_frag_init(struct radio_frag_s *frag, struct radio_data_s *tx, struct radio_data_s *rx, uint16_t peer);
+#if RADIO_ARQ == 1
+int radio433_frag_arq(struct radio_frag_s *frag, struct radio_arq_s *arq);
+#endif
+int radio433_frag_send(struct radio_frag_s *frag, uint8_t *data, uint16_t size);
+int radio433_frag_recv(struct radio_frag_s *frag, uint8_t *buf, uint16_t *size);
+int radio433_frag_poll(struct radio_frag_s *frag);
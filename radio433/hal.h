@@ -0,0 +1,23 @@
+/* hardware access of the radio433 FSM: the timer bound to each radio
+ * (CTC mode, an interrupt per bit period) and the RX pin. hal_avr.c
+ * drives the AVR timers, sim/hal_sim.c simulated ones on a host */
+
+/* input (PIN) and direction (DDR) registers are found right below the
+ * PORT register */
+#define PIN_REG(port)		(*((port) - 2))
+#define DDR_REG(port)		(*((port) - 1))
+
+/* timer counts the RX sample burst starts before the sample point */
+#define RX_BURST(top)		(((top) >> 4) * (RX_SAMPLES >> 1))
+
+#ifndef RADIO_SIM
+#define hal_pin_read(port, mask)	(PIN_REG(port) & (mask))
+#else
+uint8_t hal_pin_read(volatile uint8_t *port, uint8_t mask);
+#endif
+
+int hal_timer_start(uint8_t timer, uint16_t baud);
+void hal_timer_stop(uint8_t timer);
+void hal_timer_rephase(uint8_t timer, uint16_t count);
+uint16_t hal_timer_count(uint8_t timer, uint16_t *top);
+uint8_t hal_timer_pending(uint8_t timer);
@@ -0,0 +1,266 @@
+/* file:          hal_avr.c
+ * description:   radio433 hardware access, AVR timers
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include <hal.h>
+#include <prof.h>
+
+#if PROF_ISR == 1 && PROF_TIMER == 1 && USE_TIMER1 == 1
+#error "PROF_ISR: the profiler timer (timer 1) is RADIO_TIMER1, use another radio timer or an ATmega2560"
+#endif
+
+/* timer backends: each radio instance is bound to a timer in CTC
+ * mode, interrupting once per bit period */
+int hal_timer_start(uint8_t timer, uint16_t baud)
+{
+	switch (timer) {
+#if USE_TIMER0 == 1
+#ifdef ATMEGA8
+#error "timer0 has no compare unit on the ATmega8"
+#endif
+	case RADIO_TIMER0:
+		/* clear timer0 registers, turn on CTC mode */
+		TCNT0 = 0;
+		TCCR0A = (1 << WGM01);
+		TCCR0B = 0;
+		
+		if (baud >= 1000) {
+			OCR0A = ((F_CPU / 64) / baud) - 1;
+			TCCR0B |= (1 << CS01) | (1 << CS00);		/* clk / 64 (prescaler) */
+		} else if (baud >= 250) {
+			OCR0A = ((F_CPU / 256) / baud) - 1;
+			TCCR0B |= (1 << CS02);				/* clk / 256 (prescaler) */
+		} else {
+			OCR0A = ((F_CPU / 1024) / baud) - 1;
+			TCCR0B |= (1 << CS02) | (1 << CS00);		/* clk / 1024 (prescaler) */
+		}
+		
+		/* enable timer0 interrupts */
+		TIMSK0 |= (1 << OCIE0A);
+		break;
+#endif
+#if USE_TIMER1 == 1
+	case RADIO_TIMER1:
+		/* clear timer1 registers, turn on CTC mode, clk / 8 (prescaler).
+		 * timer1 is 16 bit, so a single prescaler covers all rates */
+		TCNT1 = 0;
+		TCCR1A = 0;
+		TCCR1B = (1 << WGM12) | (1 << CS11);
+		OCR1A = ((F_CPU / 8) / baud) - 1;
+		
+		/* enable timer1 interrupts */
+#ifndef ATMEGA8
+		TIMSK1 |= (1 << OCIE1A);
+#else
+		TIMSK |= (1 << OCIE1A);
+#endif
+		break;
+#endif
+#if USE_TIMER2 == 1
+	case RADIO_TIMER2:
+		/* clear timer2 registers */
+		TCNT2 = 0;
+#ifndef ATMEGA8
+		TCCR2A = 0;
+		TCCR2B = 0;
+#else
+		TCCR2 = 0;
+#endif
+
+		/* turn on CTC mode, timer2
+		 * clear on compare and match */
+#ifndef ATMEGA8
+		TCCR2A |= (1 << WGM21);
+#else
+		TCCR2 |= (1 << WGM21);
+#endif
+	
+#ifndef ATMEGA8
+		if (baud >= 1000) {
+			OCR2A = ((F_CPU / 64) / baud) - 1;
+			TCCR2B |= (1 << CS22);					/* clk / 64 (prescaler) */
+		} else if (baud >= 250) {
+			OCR2A = ((F_CPU / 256) / baud) - 1;
+			TCCR2B |= (1 << CS22) | (1 << CS21);			/* clk / 256 (prescaler) */
+		} else {
+			OCR2A = ((F_CPU / 1024) / baud) - 1;
+			TCCR2B |= (1 << CS22) | (1 << CS21) | (1 << CS20);	/* clk / 1024 (prescaler) */
+		}
+	
+		/* enable timer2 interrupts */
+		TIMSK2 |= (1 << OCIE2A);
+#else
+		if (baud >= 1000) {
+			OCR2 = ((F_CPU / 64) / baud) - 1;
+			TCCR2 |= (1 << CS22);					/* clk / 64 (prescaler) */
+		} else if (baud >= 250) {
+			OCR2 = ((F_CPU / 256) / baud) - 1;
+			TCCR2 |= (1 << CS22) | (1 << CS21);			/* clk / 256 (prescaler) */
+		} else {
+			OCR2 = ((F_CPU / 1024) / baud) - 1;
+			TCCR2 |= (1 << CS22) | (1 << CS21) | (1 << CS20);	/* clk / 1024 (prescaler) */
+		}
+	
+		/* enable timer2 interrupts */
+		TIMSK |= (1 << OCIE2);
+#endif
+		break;
+#endif
+	default:
+		return ERR_CONFIG;
+	}
+	
+	return ERR_OK;
+}
+
+void hal_timer_stop(uint8_t timer)
+{
+	/* stop the timer and disable its interrupts */
+	switch (timer) {
+#if USE_TIMER0 == 1
+	case RADIO_TIMER0:
+		TIMSK0 &= ~(1 << OCIE0A);
+		TCCR0B = 0;
+		break;
+#endif
+#if USE_TIMER1 == 1
+	case RADIO_TIMER1:
+#ifndef ATMEGA8
+		TIMSK1 &= ~(1 << OCIE1A);
+#else
+		TIMSK &= ~(1 << OCIE1A);
+#endif
+		TCCR1B = 0;
+		break;
+#endif
+#if USE_TIMER2 == 1
+	case RADIO_TIMER2:
+#ifndef ATMEGA8
+		TIMSK2 &= ~(1 << OCIE2A);
+		TCCR2B = 0;
+#else
+		TIMSK &= ~(1 << OCIE2);
+		TCCR2 = 0;
+#endif
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+static uint16_t hal_phase(uint16_t now, uint16_t count, uint16_t top)
+{
+	/* counts gone by since the edge (the timer may have wrapped), on
+	 * top of 1/8th period. if the edge is that old, interrupt at once */
+	if (now < count)
+		now += top + 1;
+	now = now - count + (top >> 3) + RX_BURST(top);
+	
+	return now > top ? top : now;
+}
+
+void hal_timer_rephase(uint8_t timer, uint16_t count)
+{
+	/* move the timer to where it would be if it was 1/8th period into
+	 * a period at the edge, seen when it was at count. so we interrupt
+	 * a bit earlier and sample data at the right time for this word (a
+	 * bit more with majority vote, so the sample burst is centred on
+	 * that time), no matter how long it took to get here from the edge.
+	 * a compare match that is already pending is dropped */
+	switch (timer) {
+#if USE_TIMER0 == 1
+	case RADIO_TIMER0:
+		TCNT0 = hal_phase(TCNT0, count, OCR0A);
+		TIFR0 = (1 << OCF0A);
+		break;
+#endif
+#if USE_TIMER1 == 1
+	case RADIO_TIMER1:
+		TCNT1 = hal_phase(TCNT1, count, OCR1A);
+#ifndef ATMEGA8
+		TIFR1 = (1 << OCF1A);
+#else
+		TIFR = (1 << OCF1A);
+#endif
+		break;
+#endif
+#if USE_TIMER2 == 1
+	case RADIO_TIMER2:
+#ifndef ATMEGA8
+		TCNT2 = hal_phase(TCNT2, count, OCR2A);
+		TIFR2 = (1 << OCF2A);
+#else
+		TCNT2 = hal_phase(TCNT2, count, OCR2);
+		TIFR = (1 << OCF2);
+#endif
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+uint16_t hal_timer_count(uint8_t timer, uint16_t *top)
+{
+	/* current count and period (compare value) of the radio timer */
+	switch (timer) {
+#if USE_TIMER0 == 1
+	case RADIO_TIMER0:
+		*top = OCR0A;
+		return TCNT0;
+#endif
+#if USE_TIMER1 == 1
+	case RADIO_TIMER1:
+		*top = OCR1A;
+		return TCNT1;
+#endif
+#if USE_TIMER2 == 1
+	case RADIO_TIMER2:
+#ifndef ATMEGA8
+		*top = OCR2A;
+#else
+		*top = OCR2;
+#endif
+		return TCNT2;
+#endif
+	default:
+		*top = 0;
+		return 0;
+	}
+}
+
+uint8_t hal_timer_pending(uint8_t timer)
+{
+	/* a compare match not handled by the timer ISR yet */
+	switch (timer) {
+#if USE_TIMER0 == 1
+	case RADIO_TIMER0:
+		return TIFR0 & (1 << OCF0A);
+#endif
+#if USE_TIMER1 == 1
+	case RADIO_TIMER1:
+#ifndef ATMEGA8
+		return TIFR1 & (1 << OCF1A);
+#else
+		return TIFR & (1 << OCF1A);
+#endif
+#endif
+#if USE_TIMER2 == 1
+	case RADIO_TIMER2:
+#ifndef ATMEGA8
+		return TIFR2 & (1 << OCF2A);
+#else
+		return TIFR & (1 << OCF2);
+#endif
+#endif
+	default:
+		return 0;
+	}
+}
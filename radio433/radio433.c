@@ -12,417 +12,1763 @@
 #include <string.h>
 #include <printf.h>
 #include <crc.h>
+#include <rs.h>
 #include <radio433.h>
+#include <hal.h>
+#include <prof.h>
 
 
-#if ENCODE4B5B == 1
+#if RX_SLOTS & (RX_SLOTS - 1)
+#error "RX_SLOTS must be a power of 2"
+#endif
+
+#if TXQ_SLOTS & (TXQ_SLOTS - 1)
+#error "TXQ_SLOTS must be a power of 2"
+#endif
+
+#if AIR_FRAME_SIZE > 63
+#error "frames on the air must not be larger than 63 bytes"
+#endif
+
+#if RADIO_RS == 1 && RS_PARITY > RS_MAX_PARITY
+#error "RS_PARITY must not be greater than RS_MAX_PARITY"
+#endif
+
+#if RADIO_AUTOBAUD == 1 && RX_EDGE == 0
+#error "RADIO_AUTOBAUD requires RX_EDGE"
+#endif
+
+#if RX_SAMPLES != 1 && RX_SAMPLES != 3 && RX_SAMPLES != 5
+#error "RX_SAMPLES must be 1, 3 or 5"
+#endif
+
+/* majority vote: the sample bursts of the radios on an MCU must fit
+ * (radio433_votelimit()). the host build runs each radio as a node of
+ * its own, so there they don't hold each other back */
+#if RX_SAMPLES > 1 && !defined(RADIO_SIM)
+#define VOTE_LIMIT		1
+#else
+#define VOTE_LIMIT		0
+#endif
+
+/* a byte decoded from a word with invalid symbols (4b5b) */
+#define DECODE_ERASED		0x100
+
+/* the strobe tail and sync pattern (and network word) the correlator
+ * looks for, as a window of the last SYNC_BITS samples */
+#define SYNC_PATTERN		((0xaaUL << TSYNC) | (((1UL << (TSYNC >> 1)) - 1) << (TSYNC >> 1)))
+#define SYNC_BITS		(8 + TSYNC + TNETWORK)
+#define SYNC_MASK		((1UL << SYNC_BITS) - 1)
+
+/* reasons for a bad data word */
+#define BAD_FRAMING		1
+#define BAD_SYMBOL		2
+
+/* rxbad of a frame for another node, followed to its end in a burst */
+#define RX_FILTERED		2
+
+/* bytes at the end of a frame not covered by the CRC computed by the RX
+ * FSM (the CRC itself and RS parity) */
+#if RADIO_RS == 1
+#define CRC_TRAIL		(2 + RS_PARITY)
+#else
+#define CRC_TRAIL		2
+#endif
+
 const uint8_t encode4b5b[] = {
 	0x05, 0x06, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
 	0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x19, 0x1a
 };
 
+/* invalid symbols are decoded as 0x10 */
 const uint8_t decode4b5b[] = {
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
-	0x00, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x00,
-	0x00, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x00,
-	0x00, 0x0e, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x01, 0x10,
+	0x10, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10,
+	0x10, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x10,
+	0x10, 0x0e, 0x0f, 0x10, 0x10, 0x10, 0x10, 0x10
+};
+
+#if RADIO_FEC == 1
+/* extended hamming (8,4) code words. bit n holds code position n: parity
+ * in positions 1, 2 and 4, data in 3, 5, 6 and 7 and the overall parity
+ * in bit 0. code words are XORed with 0x11 (not a code word), so there
+ * are no runs longer than 6 bits on the air */
+const uint8_t hamming84[] = {
+	0x11, 0x1e, 0x22, 0x2d, 0x44, 0x4b, 0x77, 0x78,
+	0x87, 0x88, 0xb4, 0xbb, 0xd2, 0xdd, 0xe1, 0xee
 };
 #endif
 
-volatile struct radio_data_s *radioptr;
+/* radio instances, one for each timer */
+static struct radio_data_s *radios[RADIO_TIMERS];
 
-#ifndef ATMEGA8
-ISR(TIMER2_COMPA_vect){
+static uint8_t radio433_tbyte(uint8_t coding)
+{
+	/* data word length (1 to 0 pattern and a coded byte) */
+	switch (coding) {
+	case CODING_RAW:
+	case CODING_SCRAMBLED:
+		return TBYTE_RAW;
+	case CODING_MANCHESTER:
+		return TBYTE_MANCHESTER;
+	default:
+#if RADIO_FEC == 1
+		return TBYTE_FEC;
 #else
-ISR(TIMER2_COMP_vect){
+		return TBYTE_4B5B;
 #endif
-	uint8_t byte;
-	static uint16_t rfdata;
+	}
+}
+
+static uint8_t radio433_scramble(uint8_t *lfsr)
+{
+	uint8_t i, mask = 0;
 	
-	/* TX FSM */
-	if (radioptr->direction == TX) {
-		switch (radioptr->state) {
-		case READY:
-			break;
-		case START:
-			/* received a START signal, then start TX */
-			radioptr->state = STROBE;
-			radioptr->tbit = TSTROBE - 1;
-			break;
-		case STROBE:
-			/* send a strobe signal to calibrate the RX AGC */
-			TX_PORT ^= (1 << TX_PIN);
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				radioptr->state = SYNC;
-				radioptr->tbit = TSYNC - 1;
-			}
-			break;
-		case SYNC:
-			/* send sync pattern (half T high, half T low) */
-			if (radioptr->tbit >= TSYNC >> 1) {
-				TX_PORT |= (1 << TX_PIN);
-			} else {
-				TX_PORT &= ~(1 << TX_PIN);
+	/* next 8 bits of the scrambler sequence (x^8 + x^6 + x^5 + x^4 + 1
+	 * galois LFSR, restarted for each frame) */
+	for (i = 0; i < 8; i++) {
+		mask = (mask << 1) | (*lfsr & 1);
+		if (*lfsr & 1)
+			*lfsr = (*lfsr >> 1) ^ 0xb8;
+		else
+			*lfsr >>= 1;
+	}
+	
+	return mask;
+}
+
+static uint16_t radio433_encode4b5b(uint8_t byte)
+{
+	return (encode4b5b[byte >> 4] << 5) | encode4b5b[byte & 0xf];
+}
+
+static int16_t radio433_decode4b5b(uint16_t word)
+{
+	uint8_t hi, lo;
+	int16_t byte;
+	
+	hi = decode4b5b[(word >> 5) & 0x1f];
+	lo = decode4b5b[word & 0x1f];
+	byte = ((hi & 0xf) << 4) | (lo & 0xf);
+	if ((hi | lo) & 0x10)
+		byte |= DECODE_ERASED;
+	
+	return byte;
+}
+
+static uint16_t radio433_encode(uint8_t coding, uint8_t byte, uint8_t *lfsr)
+{
+	uint16_t word = 0;
+	uint8_t i;
+	
+	/* encode a byte in a word (without the 1 to 0 pattern in front) */
+	switch (coding) {
+	case CODING_RAW:
+		return byte;
+	case CODING_SCRAMBLED:
+		return byte ^ radio433_scramble(lfsr);
+	case CODING_MANCHESTER:
+		/* 1 is sent as 10 and 0 as 01 */
+		for (i = 0; i < 8; i++) {
+			word = (word << 2) | ((byte & 0x80) ? 0x2 : 0x1);
+			byte <<= 1;
+		}
+		return word;
+	default:
+#if RADIO_FEC == 1
+		return (hamming84[byte >> 4] << 8) | hamming84[byte & 0xf];
+#else
+		return radio433_encode4b5b(byte);
+#endif
+	}
+}
+
+#if RADIO_FEC == 1
+static int8_t radio433_hamming(struct radio_data_s *radio, uint8_t code)
+{
+	uint8_t i, word, syndrome = 0, parity = 0;
+	
+	/* the syndrome is the position of a single bit error, the overall
+	 * parity tells single (odd) from double (even) errors */
+	code ^= 0x11;
+	word = code;
+	for (i = 0; i < 8; i++) {
+		if (word & 1) {
+			syndrome ^= i;
+			parity ^= 1;
+		}
+		word >>= 1;
+	}
+	
+	if (parity) {
+		code ^= 1 << syndrome;
+		radio->stats.corrected++;
+	} else if (syndrome) {
+		return -1;
+	}
+	
+	return ((code >> 3) & 0x01) | ((code >> 4) & 0x0e);
+}
+#endif
+
+static int16_t radio433_decode(struct radio_data_s *radio, uint16_t word)
+{
+	int16_t byte = 0;
+	uint8_t i, erased = 0;
+#if RADIO_FEC == 1
+	int8_t hi, lo;
+#endif
+	
+	/* decode a received data word into a byte, using the coding of the
+	 * frame. returns -1 if the word has errors that can not be corrected,
+	 * or the byte with DECODE_ERASED set if there are invalid symbols */
+	switch (radio->rxcoding) {
+	case CODING_RAW:
+		return word & 0xff;
+	case CODING_SCRAMBLED:
+		return (word ^ radio433_scramble((uint8_t *)&radio->lfsr)) & 0xff;
+	case CODING_MANCHESTER:
+		/* 00 and 11 are not valid */
+		for (i = 0; i < 8; i++) {
+			switch (word >> 14) {
+			case 0x2:
+				byte = (byte << 1) | 1;
+				break;
+			case 0x1:
+				byte <<= 1;
+				break;
+			default:
+				byte <<= 1;
+				erased = 1;
 			}
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				radioptr->state = PAYLOAD;
-				radioptr->tbit = TBYTE - 1;
+			word <<= 2;
+		}
+		return erased ? (byte | DECODE_ERASED) : byte;
+	default:
+#if RADIO_FEC == 1
+		hi = radio433_hamming(radio, word >> 8);
+		lo = radio433_hamming(radio, word & 0xff);
+		if (hi < 0 || lo < 0)
+			return -1;
+		
+		return (hi << 4) | lo;
+#else
+		return radio433_decode4b5b(word);
+#endif
+	}
+}
+
+static void radio433_emit(volatile struct radio_txframe_s *frame, uint16_t word, uint8_t bits)
+{
+	/* append the lower bits of a word to the stream, MSB first */
+	while (bits--) {
+		if ((word >> bits) & 1)
+			frame->stream[frame->bits >> 3] |= 0x80 >> (frame->bits & 7);
+		frame->bits++;
+	}
+}
+
+static void radio433_render(struct radio_data_s *radio, volatile struct radio_txframe_s *frame,
+	uint8_t *data, uint8_t payload)
+{
+	uint8_t i, lfsr, coding, tbyte;
+	
+	coding = radio->coding;
+	tbyte = radio433_tbyte(coding);
+	
+	memset((char *)frame->stream, 0, STREAM_SIZE);
+	frame->bits = 0;
+	
+	/* training strobe (on/off, not encoded) to calibrate the RX AGC */
+	for (i = 0; i < TSTROBE >> 1; i++)
+		radio433_emit(frame, 0x2, 2);
+	
+	/* sync pattern (half T high, half T low) */
+	radio433_emit(frame, ((1 << (TSYNC >> 1)) - 1) << (TSYNC >> 1), TSYNC);
+	
+#if SYNC_NETWORK == 1
+	/* network id, receivers of other networks don't sync */
+	radio433_emit(frame, radio433_encode4b5b(radio->network), TNETWORK);
+#endif
+	
+	/* frame length and coding of the data words (always 4b5b). frames
+	 * in a burst are sent from here on, in place of the leadout of the
+	 * previous frame */
+	radio433_emit(frame, 0x2, 2);
+	radio433_emit(frame, radio433_encode4b5b((coding << 6) | payload), THEADER - 2);
+	
+	/* data words. each word has a 1 to 0 pattern in the front */
+	lfsr = 0xff;
+	for (i = 0; i < payload; i++) {
+		radio433_emit(frame, 0x2, 2);
+		radio433_emit(frame, radio433_encode(coding, data[i], &lfsr), tbyte - 2);
+	}
+	
+#if RADIO_BURST == 0
+	/* leadout word (all zeroes) with a 1 to 0 pattern in the front */
+	radio433_emit(frame, 0x2, 2);
+	radio433_emit(frame, 0, tbyte - 2);
+#endif
+}
+
+static uint8_t radio433_txpending(struct radio_data_s *radio)
+{
+	uint8_t prio, pending = 0;
+	
+	/* a bit for each priority level with frames queued */
+	for (prio = 0; prio < TX_PRIOS; prio++)
+		if (radio->txhead[prio] != radio->txtail[prio])
+			pending |= (1 << prio);
+	
+	return pending;
+}
+
+static volatile struct radio_txframe_s *radio433_next(struct radio_data_s *radio, uint8_t *prio)
+{
+	/* the next frame, from the highest priority queue that has one */
+	for (*prio = TX_PRIOS; (*prio)--; )
+		if (radio->txhead[*prio] != radio->txtail[*prio])
+			return &radio->txbuf->txq[*prio][radio->txhead[*prio] % TXQ_SLOTS];
+	
+	return 0;
+}
+
+static int radio433_load(struct radio_data_s *radio, uint16_t skip)
+{
+	volatile struct radio_txframe_s *frame;
+	uint8_t prio;
+	
+	/* point the TX FSM at the stream of the next frame, rendered when
+	 * it was queued. it keeps its slot until it is out */
+	frame = radio433_next(radio, &prio);
+	if (!frame)
+		return 0;
+	
+	radio->txprio = prio;
+	radio->sptr = frame->stream + (skip >> 3);
+	radio->smask = 0x80 >> (skip & 7);
+	radio->sbits = frame->bits - skip;
+#if RADIO_STAMPS == 1
+	radio->txcur.queued = frame->queued;
+	radio->txcur.start = radio->ticks;
+#endif
+	
+	return 1;
+}
+
+static uint8_t radio433_sample(struct radio_data_s *radio)
+{
+	/* poll data - zero or one in the wire? */
+	return hal_pin_read(radio->rxport, radio->rxmask) ? 1 : 0;
+}
+
+#if RX_SAMPLES > 1
+static uint8_t radio433_vote(struct radio_data_s *radio)
+{
+	uint16_t start, top, step;
+	uint8_t i, ones = 0;
+	
+	/* take RX_SAMPLES samples 1/16th period apart (timed by the radio
+	 * timer) and decide the bit by majority. a short noise spike only
+	 * flips one of them */
+	start = hal_timer_count(radio->timer, &top);
+	step = top >> 4;
+	for (i = 0; i < RX_SAMPLES; i++) {
+		while ((uint16_t)(hal_timer_count(radio->timer, &top) - start) < i * step);
+		ones += radio433_sample(radio);
+	}
+	
+	return ones > (RX_SAMPLES >> 1);
+}
+#else
+#define radio433_vote(radio)	radio433_sample(radio)
+#endif
+
+#if VOTE_LIMIT == 1
+static int radio433_votelimit(struct radio_data_s *radio, uint8_t timer, uint16_t baud, uint8_t rx)
+{
+	uint16_t rate[RADIO_TIMERS];
+	uint8_t vote[RADIO_TIMERS], i, j;
+	uint32_t load;
+	
+	/* radios on the MCU once this one is attached: their rates and
+	 * whether they receive (and so vote) */
+	for (i = 0; i < RADIO_TIMERS; i++) {
+		rate[i] = 0;
+		vote[i] = 0;
+		if (!radios[i] || radios[i] == radio)
+			continue;
+#if RADIO_AUTOBAUD == 1
+		/* the rate of an autobaud radio follows the frames it gets,
+		 * so it must be the only radio */
+		if (radios[i]->autobaud)
+			return ERR_CONFIG;
+#endif
+		rate[i] = radios[i]->baud;
+		vote[i] = radios[i]->direction == RX || radios[i]->duplex;
+	}
+	rate[timer] = baud;
+	vote[timer] = rx;
+	
+	/* the vote burst of a RX radio holds the timer ISRs of the other
+	 * radios back by (RX_SAMPLES - 1) / 16 of its own bit period. the
+	 * bursts of the others must take at most 1/4 of the bit period of
+	 * each radio, so its samples (or TX bits) stay well inside the bit:
+	 * the sum of (RX_SAMPLES - 1) * baud / their baud is at most 4 */
+	for (i = 0; i < RADIO_TIMERS; i++) {
+		if (!rate[i])
+			continue;
+		load = 0;
+		for (j = 0; j < RADIO_TIMERS; j++)
+			if (j != i && vote[j])
+				load += ((uint32_t)(RX_SAMPLES - 1) * rate[i] << 8) / rate[j];
+		if (load > (4 << 8))
+			return ERR_CONFIG;
+	}
+	
+	return ERR_OK;
+}
+#else
+#define radio433_votelimit(radio, timer, baud, rx)	ERR_OK
+#endif
+
+#if RX_EDGE == 1
+#ifdef ATMEGA8
+#error "RX_EDGE requires pin change interrupts"
+#endif
+
+#if RADIO_AUTOBAUD == 1
+static void radio433_hunt(struct radio_data_s *radio)
+{
+	/* run the timer at the highest rate (time base) and let the pin
+	 * change interrupt measure the strobe of the next frame */
+	hal_timer_start(radio->timer, AUTOBAUD_HUNT);
+	radio->state = BAUD;
+	radio->abedges = 0;
+	radio->ablevel = radio433_sample(radio);
+	PCIFR = (1 << RX_PCIF);
+	RX_PCMSK |= radio->rxmask;
+}
+
+static uint32_t radio433_now(struct radio_data_s *radio, uint16_t *top)
+{
+	uint16_t count, ticks;
+	uint8_t pending;
+	
+	/* time in timer counts. a compare match not handled by the timer
+	 * ISR yet (we are inside the pin change ISR) is one more tick */
+	count = hal_timer_count(radio->timer, top);
+	pending = hal_timer_pending(radio->timer);
+	
+	ticks = radio->abticks;
+	if (pending && count < (*top >> 1))
+		ticks++;
+	
+	return (uint32_t)ticks * (*top + 1) + count;
+}
+
+static void radio433_measure(struct radio_data_s *radio)
+{
+	uint32_t now, interval, baud;
+	uint16_t top;
+	uint8_t level;
+	
+	/* not our pin */
+	level = radio433_sample(radio);
+	if (level == radio->ablevel)
+		return;
+	radio->ablevel = level;
+	
+	now = radio433_now(radio, &top);
+	interval = now - radio->abstamp;
+	radio->abstamp = now;
+	
+	/* strobe edges are one bit period apart. start over from this
+	 * interval if it is off by more than 1/4 from the first one */
+	if (radio->abedges == 0 || interval < radio->abfirst - (radio->abfirst >> 2) ||
+	    interval > radio->abfirst + (radio->abfirst >> 2)) {
+		radio->abfirst = interval;
+		radio->absum = interval;
+		radio->abedges = 1;
+		
+		return;
+	}
+	
+	radio->absum += interval;
+	if (++radio->abedges < AUTOBAUD_EDGES)
+		return;
+	
+	/* lock to the measured rate (if it is supported) and hunt for the
+	 * sync at the usual sample point, 7/8th of a period after the edge */
+	radio->abedges = 0;
+	baud = ((uint32_t)AUTOBAUD_HUNT * (top + 1) * AUTOBAUD_EDGES) / radio->absum;
+	if (baud < 100 || baud > 5000)
+		return;
+	
+	RX_PCMSK &= ~radio->rxmask;
+	hal_timer_start(radio->timer, baud);
+	hal_timer_rephase(radio->timer, hal_timer_count(radio->timer, &top));
+	radio->baud = baud;
+	radio->ablock = AUTOBAUD_WAIT;
+	radio->state = START;
+}
+#endif
+
+ISR(RX_PCINT_vect)
+{
+	struct radio_data_s *radio;
+	uint16_t count[RADIO_TIMERS], top;
+	uint8_t i;
+	
+	PROF_ENTER();
+	
+	/* timer counts at the edge (as close as we get to it), before
+	 * looking at the pins of each instance takes any time */
+	for (i = 0; i < RADIO_TIMERS; i++)
+		if (radios[i] && radios[i]->edge)
+			count[i] = hal_timer_count(i, &top);
+	
+	/* find the RX instances waiting for a word sync. we only care
+	 * about the falling edge (1 to 0), so compute the sample point
+	 * from it: next timer interrupt 7/8th of a period after the edge,
+	 * wherever the timer is by now */
+	for (i = 0; i < RADIO_TIMERS; i++) {
+		radio = radios[i];
+		if (!radio)
+			continue;
+		
+#if RADIO_AUTOBAUD == 1
+		/* instances measuring the strobe take every edge */
+		if (radio->state == BAUD && radio->direction == RX) {
+			radio433_measure(radio);
+			continue;
+		}
+#endif
+		if (!radio->edge || radio433_sample(radio))
+			continue;
+		
+		RX_PCMSK &= ~radio->rxmask;
+		hal_timer_rephase(radio->timer, count[i]);
+		radio->edge = 0;
+		radio->tbit--;
+	}
+	PROF_EXIT(PROF_RADIO_EDGE);
+}
+#endif
+
+static uint8_t radio433_correlate(struct radio_data_s *radio)
+{
+	uint32_t diff;
+	uint8_t errors = 0;
+	
+	/* compare the last samples to the pattern, a frame starts if no
+	 * more than SYNC_TOLERANCE bits are wrong. bits are counted one by
+	 * one, and only up to the tolerance, so this is quick */
+#if SYNC_NETWORK == 1
+	diff = (radio->corr ^ radio->sync) & SYNC_MASK;
+	/* some network ids are a single bit apart, so no errors there */
+	if (diff & ((1UL << TNETWORK) - 1))
+		return 0;
+#else
+	diff = (radio->corr ^ SYNC_PATTERN) & SYNC_MASK;
+#endif
+	while (diff) {
+		if (errors++ == SYNC_TOLERANCE)
+			return 0;
+		diff &= diff - 1;
+	}
+	
+	return 1;
+}
+
+static void radio433_wordsync(struct radio_data_s *radio)
+{
+	uint16_t top;
+	
+#if RX_EDGE == 0
+	/* wait for the falling edge (1 to 0) */
+	while (radio433_sample(radio));
+#else
+	/* still in the 1 sync bit, so arm the pin change interrupt and
+	 * let it find the edge. if it doesn't show up, give up */
+	if (radio433_sample(radio)) {
+		if (!radio->edge) {
+			radio->edge = EDGE_TIMEOUT;
+			PCIFR = (1 << RX_PCIF);
+			RX_PCMSK |= radio->rxmask;
+		} else {
+			if (--radio->edge == 0) {
+				RX_PCMSK &= ~radio->rxmask;
+				radio->stats.frame_errors++;
+				radio->stats.framing_errors++;
+				radio->state = ERROR;
 			}
-			break;
-		case PAYLOAD:
-			/* send the payload, one bit at a time. we start
-			 * appending a 1 to 0 pattern to the front */
-			byte = radioptr->payload;
-#if ENCODE4B5B == 0
-			rfdata = 0x200 | byte;
+		}
+		
+		return;
+	}
+	
+	/* the edge was missed, it already happened */
+	RX_PCMSK &= ~radio->rxmask;
+	radio->edge = 0;
+#endif
+	radio->tbit--;
+	hal_timer_rephase(radio->timer, hal_timer_count(radio->timer, &top));
+}
+
+static void radio433_header(struct radio_data_s *radio, int16_t val)
+{
+	volatile struct radio_frame_s *slot;
+	
+	/* bad start bits, invalid symbols, payload greater than expected or
+	 * zero, not good */
+	radio->payload = val & 0x3f;
+	if ((radio->rfdata & (1 << (THEADER - 2))) || (val & DECODE_ERASED) ||
+	    radio->payload == 0 || radio->payload > AIR_FRAME_SIZE) {
+		radio->stats.length_errors++;
+		radio->state = ERROR;
+		radio->payload = 0;
+		return;
+	}
+	
+	/* data words follow, with the coding of this frame */
+	radio->rxcoding = (val >> 6) & 0x3;
+	radio->tbyte = radio433_tbyte(radio->rxcoding);
+	radio->lfsr = 0xff;
+	slot = &radio->rxbuf->slot[radio->tail % RX_SLOTS];
+	slot->crc = 0xffff;
+#if RADIO_RS == 1
+	slot->erasures = 0;
+#endif
+	radio->rfdata = 0;
+	radio->rxbad = 0;
+	radio->rxviol = 0;
+#if RADIO_BURST == 1
+	radio->rxburst = 0;
+#endif
+	radio->state = DATA;
+	radio->pcount = 0;
+	radio->tbit = radio->tbyte - 1;
+}
+
+static uint8_t radio433_badword(struct radio_data_s *radio, volatile struct radio_frame_s *slot, uint8_t reason)
+{
+#if RADIO_BURST == 1
+	/* already lost, its words are just being counted */
+	if (radio->rxbad)
+		return 0;
+#endif
+#if RADIO_RS == 1
+	/* bad words are erasures for the RS decoder, the frame is lost
+	 * only when there are too many */
+	if (slot->erasures < RS_PARITY) {
+		slot->erasure[slot->erasures++] = radio->pcount;
+		
+		return 0;
+	}
+#else
+	/* a few bad words may be tolerated, the CRC has the last word */
+	if (radio->rxviol++ < RX_TOLERANCE)
+		return 0;
+#endif
+	if (reason == BAD_FRAMING)
+		radio->stats.framing_errors++;
+	else
+		radio->stats.symbol_errors++;
+	
+#if RADIO_BURST == 1
+	/* frames after the first one in a burst are counted up to their
+	 * end (while word framing holds), so the rest of the burst is kept */
+	if (radio->rxburst && reason == BAD_SYMBOL) {
+		radio->rxbad = 1;
+		
+		return 0;
+	}
+#endif
+	/* garbage (a false sync or a lost frame), drop it right away and go
+	 * back hunting for a sync */
+	radio->stats.frame_errors++;
+	radio->state = ERROR;
+	
+	return 1;
+}
+
+static uint8_t radio433_match(struct radio_data_s *radio, uint16_t dst_addr)
+{
+#if RADIO_GROUPS > 0
+	uint8_t i;
+#endif
+	
+	/* our address, broadcast or a group we joined */
+	if (dst_addr == radio->address || dst_addr == BCAST_ADDR)
+		return 1;
+#if RADIO_GROUPS > 0
+	for (i = 0; i < RADIO_GROUPS; i++)
+		if (radio->group[i] && radio->group[i] == dst_addr)
+			return 1;
+#endif
+	
+	return 0;
+}
+
+#if RX_FILTER == 1
+static uint8_t radio433_filter(struct radio_data_s *radio, volatile struct radio_frame_s *slot)
+{
+	/* the address came in with bad words, let the CRC (or RS) sort
+	 * it out later */
+#if RADIO_RS == 1
+	if (slot->erasures)
+		return 0;
+#else
+	if (radio->rxviol)
+		return 0;
+#endif
+	if (radio433_match(radio, slot->data[0] | (slot->data[1] << 8)))
+		return 0;
+	
+	radio->stats.filtered++;
+#if RADIO_BURST == 1
+	/* frames after it in the burst may be ours, so keep word framing
+	 * up to its end, but it won't get to the ring */
+	radio->rxbad = RX_FILTERED;
+	
+	return 0;
+#else
+	/* stop decoding it. skip the rest of the frame (no false syncs in
+	 * its data) or go back hunting right away */
+#if FILTER_SKIP == 1
+	radio->skip = (uint16_t)(radio->payload - radio->pcount + 1) * radio->tbyte;
+#else
+	radio->skip = 1;
+#endif
+	radio->state = SKIP;
+	
+	return 1;
+#endif
+}
+#endif
+
+#if RADIO_HIST == 1
+static void radio433_histo(volatile uint16_t *bins, uint16_t time)
+{
+	uint8_t bin;
+	
+	/* log2 bins, so a few bytes cover from a bit period to seconds */
+	for (bin = 0; time > 1 && bin < HIST_BINS - 1; bin++)
+		time >>= 1;
+	bins[bin]++;
+}
+#endif
+
+#if RADIO_STAMPS == 1
+static void radio433_txend(struct radio_data_s *radio)
+{
+	/* the last bit of a frame is out, keep its timestamps */
+	radio->txcur.end = radio->ticks;
+	radio->txstamp = radio->txcur;
+#if RADIO_HIST == 1
+	radio433_histo(radio->hist.txqueue, radio->txcur.start - radio->txcur.queued);
+	radio433_histo(radio->hist.txair, radio->txcur.end - radio->txcur.start);
+#endif
+}
+#endif
+
+static void radio433_txdone(struct radio_data_s *radio)
+{
+	radio->state = READY;
+	
+	/* half duplex: go back to RX after each frame (or burst), so the
+	 * other side gets a chance to talk */
+	if (radio->duplex) {
+		radio->direction = RX;
+		radio->state = TURN;
+		radio->tbit = TTURN;
+		radio->idle = 0;
+	}
+}
+
+#if RADIO_BURST == 1
+static void radio433_burst(struct radio_data_s *radio)
+{
+	/* more frames queued: go on with the length word of the next one,
+	 * in place of the leadout */
+	if (radio->burst < BURST_FRAMES && radio433_load(radio, TSTROBE + TSYNC + TNETWORK)) {
+		radio->burst++;
+		return;
+	}
+	
+	/* the word after the last data word is the leadout (all zeroes),
+	 * shifted out by the TX FSM */
+	radio->tword = 0x2 << (THEADER - 2);
+	radio->tbit = THEADER;
+	radio->state = LEADOUT;
+	radio->burst = 0;
+}
+#endif
+
+static void radio433_fsm(struct radio_data_s *radio)
+{
+	volatile struct radio_frame_s *slot;
+	uint8_t tstate, bad;
+	int16_t val;
+	
+	/* free running time base, one tick per bit period */
+#if RADIO_AUTOBAUD == 1
+	/* hunting, the timer runs at AUTOBAUD_HUNT. the pin change interrupt
+	 * times edges in these ticks, and the time base only moves on by bit
+	 * periods of the last rate locked to, so its unit stays the same */
+	if (radio->state == BAUD && radio->direction == RX) {
+		radio->abticks++;
+		radio->abfrac += radio->baud;
+		if (radio->abfrac >= AUTOBAUD_HUNT) {
+			radio->abfrac -= AUTOBAUD_HUNT;
+			radio->ticks++;
+		}
+	} else {
+		radio->ticks++;
+	}
 #else
-			rfdata = 0x800 | (encode4b5b[byte >> 4] << 5) | encode4b5b[byte & 0xf];
+	radio->ticks++;
 #endif
-			/* encode a zero or a one in the wire */
-			if ((rfdata >> radioptr->tbit) & 1)
-				TX_PORT |= (1 << TX_PIN);
+	
+	/* TX FSM */
+	if (radio->direction == TX) {
+		switch (radio->state) {
+		case READY:
+			/* frames are rendered when they are queued, so the
+			 * next one (if any) is ready to be shifted out */
+			if (radio433_load(radio, 0))
+				tstate = DATA;
 			else
-				TX_PORT &= ~(1 << TX_PIN);
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				radioptr->state = DATA;
-				radioptr->pcount = 0;
-				radioptr->tbit = TBYTE - 1;
+				tstate = READY;
+#if RADIO_BURST == 1
+			radio->burst = 1;
+#endif
+			
+			/* half duplex: nothing else to send, go back to RX */
+			if (tstate == READY && radio->duplex) {
+				radio->direction = RX;
+				radio->tbit = TTURN;
+				tstate = TURN;
 			}
+			radio->state = tstate;
+			break;
+		case TURN:
+			/* turnaround, let the radio modules settle */
+			if (radio->tbit-- == 0)
+				radio->state = READY;
 			break;
 		case DATA:
-			/* send a data word, one bit at a time. we start
-			 * appending a 1 to 0 pattern to the front */
-			byte = radioptr->data[radioptr->pcount];
-#if ENCODE4B5B == 0
-			rfdata = 0x200 | byte;
+			/* send the next bit of the frame (strobe, sync, payload,
+			 * data and leadout words, MSB first) */
+			if (*radio->sptr & radio->smask)
+				*radio->txport |= radio->txmask;
+			else
+				*radio->txport &= ~radio->txmask;
+			radio->smask >>= 1;
+			if (!radio->smask) {
+				radio->smask = 0x80;
+				radio->sptr++;
+			}
+			if (--radio->sbits == 0) {
+				radio->stats.sent++;
+				radio->txhead[radio->txprio]++;
+#if RADIO_STAMPS == 1
+				radio433_txend(radio);
+#endif
+#if RADIO_BURST == 1
+				radio433_burst(radio);
 #else
-			rfdata = 0x800 | (encode4b5b[byte >> 4] << 5) | encode4b5b[byte & 0xf];
+				radio433_txdone(radio);
 #endif
-			/* encode a zero or a one in the wire */
-			if ((rfdata >> radioptr->tbit) & 1)
-				TX_PORT |= (1 << TX_PIN);
-			else
-				TX_PORT &= ~(1 << TX_PIN);
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				/* more data to send? */
-				if (radioptr->pcount < radioptr->payload) {
-					radioptr->pcount++;
-					radioptr->tbit = TBYTE - 1;
-				} else {
-					radioptr->state = LEADOUT;
-					radioptr->tbit = TLEADOUT - 1;
-				}
 			}
 			break;
+#if RADIO_BURST == 1
 		case LEADOUT:
-			/* send leadout word (all zeroes) but append a
-			 * 1 to 0 pattern to the front */
-#if ENCODE4B5B == 0
-			rfdata = 0x200;
-#else
-			rfdata = 0x800;
-#endif
-			if ((rfdata >> radioptr->tbit) & 1)
-				TX_PORT |= (1 << TX_PIN);
+			/* send the next bit of the leadout word, after the
+			 * last frame in the burst */
+			if ((radio->tword >> --radio->tbit) & 1)
+				*radio->txport |= radio->txmask;
 			else
-				TX_PORT &= ~(1 << TX_PIN);
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				radioptr->state = READY;
-			}
+				*radio->txport &= ~radio->txmask;
+			if (radio->tbit == 0)
+				radio433_txdone(radio);
 			break;
+#endif
 		default:
 			break;
 		};
 	}
 	
 	/* RX FSM */
-	if (radioptr->direction == RX) {
-		switch (radioptr->state) {
+	if (radio->direction == RX) {
+		switch (radio->state) {
+		case TURN:
+			/* turnaround, let the radio modules settle */
+			if (radio->tbit-- > 0)
+				break;
 		case START:
-			radioptr->state = READY;
-			radioptr->tbit = TSYNC - 1;
+			radio->state = READY;
+			radio->corr = 0;
 		case READY:
-			/* wait for a sync pattern to start RX */
-			if (RX_PORT & (1 << RX_PIN)) {
-				if (radioptr->tbit == (TSYNC >> 1))
-					radioptr->state = SYNC;
-				radioptr->tbit--;
-			} else {
-				radioptr->tbit = TSYNC - 1;
+			/* half duplex: frames waiting to be sent and no frame
+			 * is coming in, so turn around to TX. high priority
+			 * frames (control, ACKs) go right away, others wait
+			 * until no frame was on air for TIDLE bit periods in a
+			 * row, so replies are not stepped on. nothing goes
+			 * while a reply waits for the frame it answers, but
+			 * only for TREPLY bit periods: if the other side went
+			 * quiet, the reply goes as any other frame */
+			if (radio->duplex) {
+				if (radio->idle < TIDLE)
+					radio->idle++;
+				if (radio->reply)
+					radio->reply--;
+				tstate = radio433_txpending(radio);
+				if (!radio->reply && !(radio->corr & 1) &&
+				    ((tstate & (1 << PRIO_HIGH)) || (tstate && radio->idle >= TIDLE))) {
+					radio->direction = TX;
+					radio->state = TURN;
+					radio->tbit = TTURN;
+					break;
+				}
 			}
-			break;
-		case SYNC:
-			/* in sync */
-			if (radioptr->tbit > 0) {
-				radioptr->tbit--;
-			} else {
-				radioptr->state = PAYLOAD;
-				radioptr->tbit = TBYTE - 1;
+			
+#if RADIO_AUTOBAUD == 1
+			/* no sync since locking to a rate, measure it again */
+			if (radio->autobaud && --radio->ablock == 0) {
+				radio433_hunt(radio);
+				break;
+			}
+#endif
+			
+			/* wait for the strobe tail and sync pattern to start RX,
+			 * the length word comes right after it */
+			radio->corr = (radio->corr << 1) | radio433_sample(radio);
+			if (radio433_correlate(radio)) {
+				radio->stats.syncs++;
+				/* no free slot in the ring, drop the frame */
+				if ((uint8_t)(radio->tail - radio->head) >= RX_SLOTS) {
+					radio->stats.overruns++;
+					radio->state = START;
+					break;
+				}
+#if RADIO_STAMPS == 1
+				radio->rxbuf->slot[radio->tail % RX_SLOTS].stamp.start = radio->ticks;
+#endif
+				radio->state = PAYLOAD;
+				radio->tbit = THEADER - 1;
+				radio->rfdata = 0;
+				radio->idle = 0;
 			}
-			rfdata = 0;
 			break;
 		case PAYLOAD:
-			/* word sync bit, wait for the falling edge (1 to 0) and advance
-			 * the timer by 1/8th period, so we interrupt a bit earlier
-			 * and sample data at the right time for this word */
-			if (radioptr->tbit == TBYTE - 1) {
-				while (RX_PORT & (1 << RX_PIN));
-				radioptr->tbit--;
-#ifndef ATMEGA8
-				TCNT2 = OCR2A >> 3;
-#else
-				TCNT2 = OCR2 >> 3;
-#endif
+			/* word sync bit */
+			if (radio->tbit == THEADER - 1) {
+				radio433_wordsync(radio);
 				break;
 			}
 		
 			/* poll data - zero or one in the wire? */
-			if (RX_PORT & (1 << RX_PIN))
-				rfdata |= 1;
+			if (radio433_vote(radio))
+				radio->rfdata |= 1;
 			
 			/* still fetching data */	
-			if (radioptr->tbit > 0) {
-				rfdata <<= 1;
-				radioptr->tbit--;
+			if (radio->tbit > 0) {
+				radio->rfdata <<= 1;
+				radio->tbit--;
 			} else {
-			/* a word of data is ready, now decode it */
-#if ENCODE4B5B == 0
-				radioptr->payload = rfdata;
-#else
-				radioptr->payload = ((decode4b5b[rfdata >> 5] << 4) | decode4b5b[rfdata & 0x1f]);
-#endif
-				/* payload greater than expected or zero, not good */
-				if (radioptr->payload == 0 || radioptr->payload > MAX_FRAME_SIZE) {
-					radioptr->state = ERROR;
-					radioptr->payload = 0;
-					break;
-				}
-				rfdata = 0;
-				radioptr->state = DATA;
-				radioptr->pcount = 0;
-				radioptr->tbit = TBYTE - 1;
+			/* a word of data is ready, now decode it (frame
+			 * length and coding of the data words) */
+				radio433_header(radio, radio433_decode4b5b(radio->rfdata));
 			}
 			break;
 		case DATA:
-			/* word sync bit, wait for the falling edge (1 to 0) and advance
-			 * the timer by 1/8th period, so we interrupt a bit earlier
-			 * and sample data at the right time for this word */
-			if (radioptr->tbit == TBYTE - 1) {
-				while (RX_PORT & (1 << RX_PIN));
-				radioptr->tbit--;
-#ifndef ATMEGA8
-				TCNT2 = OCR2A >> 3;
-#else
-				TCNT2 = OCR2 >> 3;
-#endif
+			/* word sync bit */
+			if (radio->tbit == radio->tbyte - 1) {
+				radio433_wordsync(radio);
 				break;
 			}
 			
 			/* poll data - zero or one in the wire? */
-			if (RX_PORT & (1 << RX_PIN))
-				rfdata |= 1;
+			if (radio433_vote(radio))
+				radio->rfdata |= 1;
 			
 			/* still fetching data */
-			if (radioptr->tbit > 0) {
-				rfdata <<= 1;
-				radioptr->tbit--;
+			if (radio->tbit > 0) {
+				radio->rfdata <<= 1;
+				radio->tbit--;
 			} else {
-			/* a word of data is ready, now decode it */
-#if ENCODE4B5B == 0
-				radioptr->data[radioptr->pcount++] = rfdata;
-#else
-				radioptr->data[radioptr->pcount++] = ((decode4b5b[rfdata >> 5] << 4) | decode4b5b[rfdata & 0x1f]);
+			/* a word of data is ready, now decode it into the
+			 * slot at the tail of the ring */
+				slot = &radio->rxbuf->slot[radio->tail % RX_SLOTS];
+				val = radio433_decode(radio, radio->rfdata);
+				
+				/* each word starts with a 1 to 0 pattern and must be
+				 * a valid code word (or one the FEC corrects) */
+				if (radio->rfdata & (1 << (radio->tbyte - 2)))
+					bad = BAD_FRAMING;
+				else if (val < 0 || (val & DECODE_ERASED))
+					bad = BAD_SYMBOL;
+				else
+					bad = 0;
+				if (bad && radio433_badword(radio, slot, bad))
+					break;
+				/* update the CRC as data arrives, so it is ready
+				 * when the frame ends */
+				if (radio->pcount + CRC_TRAIL < radio->payload)
+					slot->crc = crc16ccitt_update(slot->crc, val);
+				slot->data[radio->pcount++] = val;
+				radio->rfdata = 0;
+#if RX_FILTER == 1
+				/* the destination address is in, packets for other
+				 * nodes stop here */
+				if (radio->pcount == 2 && radio->address && !radio->rxbad && radio433_filter(radio, slot))
+					break;
 #endif
-				rfdata = 0;
 				/* any more data in the stream? */
-				if (radioptr->pcount < radioptr->payload) {
-					radioptr->state = DATA;
+				if (radio->pcount < radio->payload) {
+					radio->state = DATA;
 				} else {
-					radioptr->state = LEADOUT;
+					radio->state = LEADOUT;
+#if RADIO_BURST == 1
+					/* it may be the length word of the next frame.
+					 * words of a lost frame are still counted up to
+					 * here, so the rest of the burst is not lost */
+					radio->tbyte = THEADER;
+#endif
 				}
-				radioptr->tbit = TBYTE - 1;
+				radio->tbit = radio->tbyte - 1;
 			}
 			break;
 		case LEADOUT:
 			/* word sync */
-			if (radioptr->tbit == TBYTE - 1) {
-				while (RX_PORT & (1 << RX_PIN));
-				radioptr->tbit--;
-#ifndef ATMEGA8
-				TCNT2 = OCR2A >> 3;
-#else
-				TCNT2 = OCR2 >> 3;
-#endif
+			if (radio->tbit == radio->tbyte - 1) {
+				radio433_wordsync(radio);
 				break;
 			}
 			
-			/* wait for the leadout and move to the RECV state */
-			if (radioptr->tbit == 0)
-				radioptr->state = RECV;
-			radioptr->tbit--;
-			break;
-		case RECV:
+#if RADIO_BURST == 1
+			/* poll data, the leadout or the length word of the next
+			 * frame in a burst */
+			if (radio433_vote(radio))
+				radio->rfdata |= 1;
+			
+			if (radio->tbit > 0) {
+				radio->rfdata <<= 1;
+				radio->tbit--;
+				break;
+			}
+#endif
+			/* wait for the leadout, then hand the frame over to the
+			 * application and go back hunting for a sync */
+			if (radio->tbit == 0) {
+#if RX_FILTER == 1 && RADIO_BURST == 1
+				/* a frame for another node, just the burst goes on */
+				if (radio->rxbad != RX_FILTERED) {
+#endif
+				slot = &radio->rxbuf->slot[radio->tail % RX_SLOTS];
+				slot->payload = radio->rxbad ? 0 : radio->payload;
+				slot->status = radio->rxbad ? FRAME_ERROR : FRAME_OK;
+#if RADIO_STAMPS == 1
+				slot->stamp.end = radio->ticks;
+#endif
+				if (radio->rxbad)
+					radio->stats.frame_errors++;
+				else
+					radio->stats.frames++;
+				radio->tail++;
+				/* a good frame for us is in, the reply to it goes
+				 * now (raw frames carry no address, any one will
+				 * do). bad frames and false syncs don't count */
+				if (!radio->rxbad && (!radio->address || (radio->payload >= 2 &&
+				    radio433_match(radio, slot->data[0] | (slot->data[1] << 8)))))
+					radio->reply = 0;
+#if RX_FILTER == 1 && RADIO_BURST == 1
+				}
+#endif
+				radio->state = START;
+#if RADIO_BURST == 1
+				/* a valid length word, the burst goes on (unless
+				 * there is no free slot in the ring for it) */
+				val = radio433_decode4b5b(radio->rfdata);
+				if (!(val & DECODE_ERASED) && (val & 0x3f)) {
+					if ((uint8_t)(radio->tail - radio->head) < RX_SLOTS) {
+						radio433_header(radio, val);
+						radio->rxburst = 1;
+#if RADIO_STAMPS == 1
+						/* right after the sync, as in the first frame */
+						radio->rxbuf->slot[radio->tail % RX_SLOTS].stamp.start = radio->ticks - THEADER;
+#endif
+						break;
+					}
+					radio->stats.overruns++;
+				}
+#endif
+#if RADIO_AUTOBAUD == 1
+				/* the next frame may have another rate */
+				if (radio->autobaud)
+					radio433_hunt(radio);
+#endif
+			}
+			radio->tbit--;
 			break;
 		case ERROR:
+			/* reception failed, report it in a slot so the
+			 * application knows and restart */
+			slot = &radio->rxbuf->slot[radio->tail % RX_SLOTS];
+			slot->payload = 0;
+			slot->status = FRAME_ERROR;
+			radio->tail++;
+			radio->state = START;
+#if RADIO_AUTOBAUD == 1
+			if (radio->autobaud)
+				radio433_hunt(radio);
+#endif
+			break;
+		case BAUD:
+			/* the pin change interrupt is measuring the strobe */
+			break;
+#if RX_FILTER == 1
+		case SKIP:
+			/* a frame for another node, nothing to do until its
+			 * end (or right away) */
+			if (--radio->skip)
+				break;
+			radio->state = START;
+#if RADIO_AUTOBAUD == 1
+			if (radio->autobaud)
+				radio433_hunt(radio);
+#endif
 			break;
+#endif
 		default:
 			break;
 		};
 	}
 }
 
+#if RADIO_CALLBACK == 1
+static void radio433_dispatch(struct radio_data_s *radio)
+{
+	uint8_t *data, payload;
+	uint16_t src_addr;
+	int rval;
+	
+	/* hand received packets (for us, CRC checked) to the handler at
+	 * the end of the ISR, with interrupts enabled, so the FSM and other
+	 * interrupts go on while it runs. if this ISR nests in a dispatch
+	 * already running, that one takes the new packets */
+	if (!radio->handler || radio->dispatch || radio->head == radio->tail)
+		return;
+	
+	radio->dispatch = 1;
+	sei();
+	while ((rval = radio433_acquire(radio, &src_addr, &data, &payload)) != ERR_NO_DATA &&
+	    rval != ERR_CONFIG && rval != ERR_BUSY) {
+		/* the payload is read in place, in the RX slot */
+		if (rval == ERR_OK) {
+			radio->handler(radio, src_addr, data, payload);
+			radio433_release(radio);
+		}
+	}
+	cli();
+	radio->dispatch = 0;
+}
+#endif
+
+/* the same FSM serves all radio instances, dispatched from the
+ * interrupt of the timer each one is bound to */
+#if USE_TIMER0 == 1
+ISR(TIMER0_COMPA_vect)
+{
+	PROF_ENTER();
+	radio433_fsm(radios[RADIO_TIMER0]);
+#if RADIO_CALLBACK == 1
+	radio433_dispatch(radios[RADIO_TIMER0]);
+#endif
+	PROF_EXIT(PROF_RADIO0);
+}
+#endif
+
+#if USE_TIMER1 == 1
+ISR(TIMER1_COMPA_vect)
+{
+	PROF_ENTER();
+	radio433_fsm(radios[RADIO_TIMER1]);
+#if RADIO_CALLBACK == 1
+	radio433_dispatch(radios[RADIO_TIMER1]);
+#endif
+	PROF_EXIT(PROF_RADIO1);
+}
+#endif
+
+#if USE_TIMER2 == 1
+#ifndef ATMEGA8
+ISR(TIMER2_COMPA_vect)
+#else
+ISR(TIMER2_COMP_vect)
+#endif
+{
+	PROF_ENTER();
+	radio433_fsm(radios[RADIO_TIMER2]);
+#if RADIO_CALLBACK == 1
+	radio433_dispatch(radios[RADIO_TIMER2]);
+#endif
+	PROF_EXIT(PROF_RADIO2);
+}
+#endif
+
+
+int radio433_setup(struct radio_data_s *radio, struct radio_rxbuf_s *rxbuf, struct radio_txbuf_s *txbuf,
+	uint16_t baud, uint8_t direction)
+{
+	/* default timer and pins */
+	if (direction == TX)
+		return radio433_attach(radio, rxbuf, txbuf, baud, direction, RADIO_TIMER, &TX_PORT, TX_PIN);
+	else
+		return radio433_attach(radio, rxbuf, txbuf, baud, direction, RADIO_TIMER, &RX_PORT, RX_PIN);
+}
+
+int radio433_attach(struct radio_data_s *radio, struct radio_rxbuf_s *rxbuf, struct radio_txbuf_s *txbuf,
+	uint16_t baud, uint8_t direction, uint8_t timer, volatile uint8_t *port, uint8_t pin)
+{
+	if (baud < 100 || baud > 5000)
+		return ERR_CONFIG;
+	
+	/* frame storage for our side (a RX radio given a TX buffer too
+	 * may turn half duplex later) */
+	if (direction == TX ? !txbuf : !rxbuf)
+		return ERR_CONFIG;
+	
+	if (timer >= RADIO_TIMERS)
+		return ERR_CONFIG;
+	
+	/* one radio for each timer, as the RX FSM re-phases it */
+	if (radios[timer] && radios[timer] != radio)
+		return ERR_BUSY;
+	
+	/* majority vote: the sample bursts of the radios must fit */
+	if (radio433_votelimit(radio, timer, baud, direction == RX) != ERR_OK)
+		return ERR_CONFIG;
+	
+#if RX_EDGE == 1
+	/* the pin change interrupt only covers RX_PORT */
+	if (direction == RX && port != &RX_PORT)
+		return ERR_CONFIG;
+#endif
+
+	cli();
+	
+	/* initialize radio data structure */
+	radio->rxbuf = rxbuf;
+	radio->txbuf = txbuf;
+	radio->edge = 0;
+	radio->payload = 0;
+	radio->head = 0;
+	radio->tail = 0;
+	radio->lent = 0;
+	memset((char *)&radio->stats, 0, sizeof(radio->stats));
+#if RADIO_STAMPS == 1
+	memset((char *)&radio->txstamp, 0, sizeof(radio->txstamp));
+	memset((char *)&radio->rxstamp, 0, sizeof(radio->rxstamp));
+#endif
+#if RADIO_HIST == 1
+	memset((char *)&radio->hist, 0, sizeof(radio->hist));
+#endif
+	radio->ticks = 0;
+	radio->idle = 0;
+	radio->reply = 0;
+	memset((char *)radio->txhead, 0, sizeof(radio->txhead));
+	memset((char *)radio->txtail, 0, sizeof(radio->txtail));
+	radio->direction = direction;
+	radio->state = READY;
+	radio->tbit = 0;
+	radio->corr = 0;
+	radio->timer = timer;
+	radio->baud = baud;
+	radio->duplex = 0;
+	radio->coding = RADIO_CODING;
+#if SYNC_NETWORK == 1
+	radio->network = 0;
+	radio->sync = (SYNC_PATTERN << TNETWORK) | radio433_encode4b5b(0);
+#endif
+#if RADIO_AUTOBAUD == 1
+	radio->autobaud = 0;
+	radio->abticks = 0;
+	radio->abfrac = 0;
+#endif
+	radio->address = 0;
+#if RADIO_GROUPS > 0
+	memset(radio->group, 0, sizeof(radio->group));
+#endif
+#if RADIO_CALLBACK == 1
+	radio->handler = 0;
+	radio->dispatch = 0;
+#endif
+	
+	/* setup TX or RX pin */
+	if (direction == TX) {
+		radio->txport = port;
+		radio->txmask = (1 << pin);
+		radio->rxmask = 0;
+		DDR_REG(port) |= radio->txmask;
+		*port &= ~radio->txmask;
+	} else {
+		radio->rxport = port;
+		radio->rxmask = (1 << pin);
+		radio->txmask = 0;
+		DDR_REG(port) &= ~radio->rxmask;
+		*port &= ~radio->rxmask;
+#if RX_EDGE == 1
+		/* the word sync edge interrupt is armed by the RX FSM */
+		RX_PCMSK &= ~radio->rxmask;
+		PCICR |= (1 << RX_PCIE);
+#endif
+	}
+	
+	radios[timer] = radio;
+	if (hal_timer_start(timer, baud)) {
+		radios[timer] = 0;
+		sei();
+		
+		return ERR_CONFIG;
+	}
+
+	sei();
+	
+	return ERR_OK;
+}
+
+int radio433_dettach(struct radio_data_s *radio)
+{
+	if (radio->timer >= RADIO_TIMERS || radios[radio->timer] != radio)
+		return ERR_CONFIG;
+	
+	/* release the timer, so it can be used by other drivers */
+	cli();
+	hal_timer_stop(radio->timer);
+	radios[radio->timer] = 0;
+#if RX_EDGE == 1
+	if (radio->rxmask)
+		RX_PCMSK &= ~radio->rxmask;
+#endif
+	radio->direction = NONE;
+	if (radio->txmask)
+		*radio->txport &= ~radio->txmask;
+	sei();
+	
+	return ERR_OK;
+}
 
-int radio433_setup(struct radio_data_s *radio, uint16_t baud, uint8_t direction)
+int radio433_halfduplex(struct radio_data_s *radio, volatile uint8_t *port, uint8_t pin)
 {
-	if (baud < 100 || baud > 5000)
+	/* a RX radio gets a TX pin and starts to turn around (at frame
+	 * boundaries) when there are frames to be sent */
+	if (radio->timer >= RADIO_TIMERS || radios[radio->timer] != radio)
+		return ERR_CONFIG;
+	
+	if (radio->direction != RX || !radio->txbuf)
+		return ERR_CONFIG;
+	
+#if RADIO_AUTOBAUD == 1
+	if (radio->autobaud)
+		return ERR_CONFIG;
+#endif
+	
+	cli();
+	radio->txport = port;
+	radio->txmask = (1 << pin);
+	DDR_REG(port) |= radio->txmask;
+	*port &= ~radio->txmask;
+	radio->duplex = 1;
+	sei();
+	
+	return ERR_OK;
+}
+
+int radio433_coding(struct radio_data_s *radio, uint8_t coding)
+{
+	/* line coding of frames queued from now on. receivers find out
+	 * the coding of each frame from its length word */
+	if (coding >= CODINGS)
 		return ERR_CONFIG;
 	
-	/* setup TX and RX pins */
-	TX_DIR |= (1 << TX_PIN);
-	TX_PORT &= ~(1 << TX_PIN);
+	radio->coding = coding;
 	
-	RX_DIR &= ~(1 << RX_PIN);
-	RX_PORT &= ~(1 << RX_PIN);
+	return ERR_OK;
+}
 
+int radio433_network(struct radio_data_s *radio, uint8_t network)
+{
+#if SYNC_NETWORK == 1
+	uint32_t sync;
+	
+	/* frames queued from now on are sent with this network id, and
+	 * only frames with it are received */
+	sync = (SYNC_PATTERN << TNETWORK) | radio433_encode4b5b(network);
 	cli();
+	radio->network = network;
+	radio->sync = sync;
+	sei();
 	
-	/* clear timer2 registers */
-	TCNT2 = 0;
-#ifndef ATMEGA8
-	TCCR2A = 0;
-	TCCR2B = 0;
+	return ERR_OK;
 #else
-	TCCR2 = 0;
+	return ERR_CONFIG;
 #endif
+}
 
-	/* turn on CTC mode, timer2
-	 * clear on compare and match */
-#ifndef ATMEGA8
-	TCCR2A |= (1 << WGM21);
-#else
-	TCCR2 |= (1 << WGM21);
+int radio433_autobaud(struct radio_data_s *radio)
+{
+#if RADIO_AUTOBAUD == 1
+#if VOTE_LIMIT == 1
+	uint8_t i;
 #endif
 	
-#ifndef ATMEGA8
-	if (baud >= 1000) {
-		OCR2A = ((F_CPU / 64) / baud) - 1;
-		TCCR2B |= (1 << CS22);					/* clk / 64 (prescaler) */
-	} else if (baud >= 250) {
-		OCR2A = ((F_CPU / 256) / baud) - 1;
-		TCCR2B |= (1 << CS22) | (1 << CS21);			/* clk / 256 (prescaler) */
-	} else {
-		OCR2A = ((F_CPU / 1024) / baud) - 1;
-		TCCR2B |= (1 << CS22) | (1 << CS21) | (1 << CS20);	/* clk / 1024 (prescaler) */
-	}
+	/* a RX radio follows the rate of each frame it receives (the baud
+	 * rate of the last one is kept in radio->baud) */
+	if (radio->timer >= RADIO_TIMERS || radios[radio->timer] != radio)
+		return ERR_CONFIG;
 	
-	/* enable timer2 interrupts */
-	TIMSK2 |= (1 << OCIE2A);
-#else
-	if (baud >= 1000) {
-		OCR2 = ((F_CPU / 64) / baud) - 1;
-		TCCR2 |= (1 << CS22);					/* clk / 64 (prescaler) */
-	} else if (baud >= 250) {
-		OCR2 = ((F_CPU / 256) / baud) - 1;
-		TCCR2 |= (1 << CS22) | (1 << CS21);			/* clk / 256 (prescaler) */
-	} else {
-		OCR2 = ((F_CPU / 1024) / baud) - 1;
-		TCCR2 |= (1 << CS22) | (1 << CS21) | (1 << CS20);	/* clk / 1024 (prescaler) */
-	}
+	if (radio->direction != RX || radio->duplex)
+		return ERR_CONFIG;
 	
-	/* enable timer2 interrupts */
-	TIMSK |= (1 << OCIE2);
+#if VOTE_LIMIT == 1
+	/* majority vote: its rate is not known in advance, so the sample
+	 * bursts can only be bounded with no other radio on the MCU */
+	for (i = 0; i < RADIO_TIMERS; i++)
+		if (radios[i] && radios[i] != radio)
+			return ERR_CONFIG;
 #endif
 	
-
-	/* initialize radio data structure */
-	radio->payload = 0;
-	radio->direction = direction;
-	radio->state = READY;
-	radio->tbit = TSYNC - 1;
-	radio->address = 0;
-	radioptr = radio;
-
+	cli();
+	radio->autobaud = 1;
+	radio433_hunt(radio);
 	sei();
 	
 	return ERR_OK;
+#else
+	return ERR_CONFIG;
+#endif
 }
 
 int radio433_tx(struct radio_data_s *radio, uint8_t *data, uint8_t payload)
 {
-	/* we are TX */
-	if (radio->direction != TX)
+	return radio433_txprio(radio, data, payload, PRIO_LOW);
+}
+
+int radio433_txprio(struct radio_data_s *radio, uint8_t *data, uint8_t payload, uint8_t prio)
+{
+	volatile struct radio_txframe_s *frame;
+#if RADIO_RS == 1
+	uint8_t buf[AIR_FRAME_SIZE];
+#endif
+	
+	/* we are TX (or half duplex) */
+	if ((radio->direction != TX && !radio->duplex) || prio >= TX_PRIOS)
 		return ERR_CONFIG;
 	
-	/* transmission is happening, we should wait */
-	if (radio->state != READY)
+	/* queue is full, we should wait */
+	if ((uint8_t)(radio->txtail[prio] - radio->txhead[prio]) >= TXQ_SLOTS) {
+		radio->stats.busy++;
+		
 		return ERR_BUSY;
+	}
 		
 	/* payload cannot be larger than a frame */
 	if (payload > MAX_FRAME_SIZE)
 		payload = MAX_FRAME_SIZE;
 
-	/* copy data from user buffer atomically and start the TX FSM */
-#ifndef ATMEGA8
-	TIMSK2 &= ~(1 << OCIE2A);
-#else
-	TIMSK &= ~(1 << OCIE2);
+#if RADIO_RS == 1
+	/* append RS parity to the frame */
+	memcpy(buf, data, payload);
+	rs_encode(buf, payload, RS_PARITY);
+	data = buf;
+	payload += RS_PARITY;
 #endif
-	memcpy((char *)radio->data, data, payload);
-	radio->payload = payload;
-	radio->state = START;
-	TCNT2 = 0;
-#ifndef ATMEGA8
-	TIMSK2 |= (1 << OCIE2A);
-#else
-	TIMSK |= (1 << OCIE2);
+	
+	/* the ISR only reads from the slots between the head and the tail,
+	 * so the frame is rendered (with interrupts enabled) to the tail
+	 * slot without stopping the TX FSM, which then only shifts its
+	 * bits out. it will be pulled from the queue as soon as the FSM
+	 * is done with previous frames */
+	frame = &radio->txbuf->txq[prio][radio->txtail[prio] % TXQ_SLOTS];
+	radio433_render(radio, frame, data, payload);
+#if RADIO_STAMPS == 1
+	frame->queued = radio433_ticks(radio);
 #endif
+	radio->txtail[prio]++;
 	
 	return ERR_OK;
 }
 
-int radio433_rx(struct radio_data_s *radio, uint8_t *data, uint8_t *payload)
+int radio433_reply(struct radio_data_s *radio, uint8_t *data, uint8_t payload)
+{
+	uint8_t sreg;
+	int rval;
+	
+	/* half duplex only, one reply at a time */
+	if (!radio->duplex)
+		return ERR_CONFIG;
+	
+	/* the frame is held in the queue until the RX FSM is done with the
+	 * next good frame for us (or for TREPLY bit periods), then sent as
+	 * soon as the radio turns around. so it always goes TTURN bit
+	 * periods after the frame it answers, no matter when the
+	 * application got to queue it */
+	sreg = SREG;
+	cli();
+	if (radio->reply) {
+		SREG = sreg;
+		
+		return ERR_BUSY;
+	}
+	radio->reply = TREPLY;
+	SREG = sreg;
+	
+	rval = radio433_txprio(radio, data, payload, PRIO_HIGH);
+	if (rval != ERR_OK) {
+		sreg = SREG;
+		cli();
+		radio->reply = 0;
+		SREG = sreg;
+	}
+	
+	return rval;
+}
+
+#if RADIO_STAMPS == 1
+static void radio433_rxdone(struct radio_data_s *radio, volatile struct radio_frame_s *slot)
+{
+	uint8_t sreg;
+	
+	/* timestamps of the frame the application is taking. a handler
+	 * (RADIO_CALLBACK) may take one in the middle of radio433_rxstamp(),
+	 * so they are only touched with interrupts disabled */
+	sreg = SREG;
+	cli();
+	radio->rxstamp = slot->stamp;
+	radio->rxstamp.dequeued = radio->ticks;
+#if RADIO_HIST == 1
+	radio433_histo(radio->hist.rxair, radio->rxstamp.end - radio->rxstamp.start);
+	radio433_histo(radio->hist.rxqueue, radio->rxstamp.dequeued - radio->rxstamp.end);
+#endif
+	SREG = sreg;
+}
+#endif
+
+static int radio433_rxslot(struct radio_data_s *radio, volatile struct radio_frame_s **frame)
 {
-	/* we are RX */
-	if (radio->direction != RX)
+	volatile struct radio_frame_s *slot;
+#if RADIO_RS == 1
+	int val;
+	uint8_t sreg;
+#endif
+	
+	/* we are RX (or half duplex) */
+	if (radio->direction != RX && !radio->duplex)
 		return ERR_CONFIG;
 	
+	/* the head slot is lent to the application */
+	if (radio->lent)
+		return ERR_BUSY;
+	
+	/* no frames in the ring */
+	if (radio->head == radio->tail)
+		return ERR_NO_DATA;
+	
+	/* the ISR only writes to the tail slot, so the head slot is ours
+	 * (without stopping the RX FSM) until head moves */
+	slot = &radio->rxbuf->slot[radio->head % RX_SLOTS];
+	
 	/* reception failed or problem syncing */
-	if (radio->state == ERROR) {
-		radio->state = START;
+	if (slot->status != FRAME_OK) {
+		radio->head++;
 		
 		return ERR_FRAME_ERROR;
 	}
 	
-	/* reception is happening or no data received */
-	if (radio->state != RECV)
-		return ERR_NO_DATA;
+#if RADIO_RS == 1
+	/* correct errors and erasures in place and drop the parity */
+	val = -1;
+	if (slot->payload > RS_PARITY)
+		val = rs_decode((uint8_t *)slot->data, slot->payload, RS_PARITY, (uint8_t *)slot->erasure, slot->erasures);
+	sreg = SREG;
+	cli();
+	if (val < 0)
+		radio->stats.frame_errors++;
+	else
+		radio->stats.corrected += val;
+	SREG = sreg;
+	if (val < 0) {
+		radio->head++;
+		
+		return ERR_FRAME_ERROR;
+	}
+	slot->payload -= RS_PARITY;
 	
-	/* copy data to user buffer atomically and restart the RX FSM */
-#ifndef ATMEGA8
-	TIMSK2 &= ~(1 << OCIE2A);
+	/* the CRC computed by the RX FSM covers the bytes as received */
+	if (val > 0 && slot->payload >= 2)
+		slot->crc = crc16ccitt((uint8_t *)slot->data, slot->payload - 2);
+#endif
+	*frame = slot;
+	
+	return ERR_OK;
+}
+
+static int radio433_pktslot(struct radio_data_s *radio, struct transport_s *hdr, volatile struct radio_frame_s **frame)
+{
+	volatile struct radio_frame_s *slot;
+	uint8_t size, sreg;
+	int rval;
+	
+	if (!radio->address)
+		return ERR_CONFIG;
+	
+	do {
+		/* try to receive a frame (the RX FSM computes its CRC) */
+		rval = radio433_rxslot(radio, &slot);
+		
+		/* no data or something weird happened */
+		if (rval != ERR_OK)
+			return rval;
+		
+		/* too short for a packet */
+		size = slot->payload;
+		if (size < sizeof(struct transport_s) + 2) {
+			radio->head++;
+			
+			return ERR_FRAME_ERROR;
+		}
+		
+		memcpy(hdr, (char *)slot->data, sizeof(struct transport_s));
+		
+		/* check if this data is for us (this address, broadcast or
+		 * a group) */
+		if (radio433_match(radio, hdr->dst_addr))
+			break;
+		
+		/* the RX FSM counts the ones it drops too (RX_FILTER) */
+		sreg = SREG;
+		cli();
+		radio->stats.filtered++;
+		SREG = sreg;
+		radio->head++;
+	} while (1);
+	
+	/* check CRC (of all but its last two bytes) */
+	if (slot->crc != (slot->data[size - 2] | (slot->data[size - 1] << 8))) {
+		sreg = SREG;
+		cli();
+		radio->stats.crc_errors++;
+		SREG = sreg;
+		radio->head++;
+		
+		return ERR_CRC_ERROR;
+	}
+	*frame = slot;
+	
+	return ERR_OK;
+}
+
+int radio433_rx(struct radio_data_s *radio, uint8_t *data, uint8_t *payload)
+{
+	volatile struct radio_frame_s *slot;
+	int rval;
+	
+	rval = radio433_rxslot(radio, &slot);
+	if (rval != ERR_OK)
+		return rval;
+	
+	memcpy((char *)data, (char *)slot->data, slot->payload);
+	*payload = slot->payload;
+#if RADIO_STAMPS == 1
+	radio433_rxdone(radio, slot);
+#endif
+	radio->head++;
+	
+	return ERR_OK;
+}
+
+uint16_t radio433_ticks(struct radio_data_s *radio)
+{
+	uint16_t ticks;
+	uint8_t sreg;
+	
+	/* read the time base (bit periods) atomically */
+	sreg = SREG;
+	cli();
+	ticks = radio->ticks;
+	SREG = sreg;
+	
+	return ticks;
+}
+
+void radio433_stats(struct radio_data_s *radio, struct radio_stats_s *stats, uint8_t reset)
+{
+	uint8_t sreg;
+	
+	/* take a snapshot of the counters atomically (and reset them, so
+	 * the next one covers a known period of time) */
+	sreg = SREG;
+	cli();
+	memcpy(stats, (char *)&radio->stats, sizeof(struct radio_stats_s));
+	if (reset)
+		memset((char *)&radio->stats, 0, sizeof(struct radio_stats_s));
+	SREG = sreg;
+}
+
+int radio433_txstamp(struct radio_data_s *radio, struct radio_stamp_s *stamp)
+{
+#if RADIO_STAMPS == 1
+	uint8_t sreg;
+	
+	/* timestamps of the last frame sent */
+	sreg = SREG;
+	cli();
+	memcpy(stamp, (char *)&radio->txstamp, sizeof(struct radio_stamp_s));
+	SREG = sreg;
+	
+	return ERR_OK;
 #else
-	TIMSK &= ~(1 << OCIE2);
+	return ERR_CONFIG;
 #endif
-	memcpy((char *)data, (char *)radio->data, radio->payload);
-	*payload = radio->payload;
-	radio->state = START;
-#ifndef ATMEGA8
-	TIMSK2 |= (1 << OCIE2A);
+}
+
+int radio433_rxstamp(struct radio_data_s *radio, struct radio_stamp_s *stamp)
+{
+#if RADIO_STAMPS == 1
+	uint8_t sreg;
+	
+	/* timestamps of the last frame taken by radio433_rx() */
+	sreg = SREG;
+	cli();
+	memcpy(stamp, (char *)&radio->rxstamp, sizeof(struct radio_stamp_s));
+	SREG = sreg;
+	
+	return ERR_OK;
 #else
-	TIMSK |= (1 << OCIE2);
+	return ERR_CONFIG;
 #endif
+}
+
+int radio433_hist(struct radio_data_s *radio, struct radio_hist_s *hist, uint8_t reset)
+{
+#if RADIO_HIST == 1
+	uint8_t sreg;
+	
+	/* take a snapshot of the histograms atomically, like the stats */
+	sreg = SREG;
+	cli();
+	memcpy(hist, (char *)&radio->hist, sizeof(struct radio_hist_s));
+	if (reset)
+		memset((char *)&radio->hist, 0, sizeof(struct radio_hist_s));
+	SREG = sreg;
 	
 	return ERR_OK;
+#else
+	return ERR_CONFIG;
+#endif
 }
 
 void radio433_addr(struct radio_data_s *radio, uint16_t address)
@@ -430,10 +1776,74 @@ void radio433_addr(struct radio_data_s *radio, uint16_t address)
 	radio->address = address;
 }
 
+int radio433_join(struct radio_data_s *radio, uint16_t group)
+{
+#if RADIO_GROUPS > 0
+	uint8_t i, sreg;
+	
+	if (!group || group == BCAST_ADDR)
+		return ERR_CONFIG;
+	
+	for (i = 0; i < RADIO_GROUPS; i++)
+		if (radio->group[i] == group)
+			return ERR_OK;
+	
+	/* packets to this address are ours too (the RX FSM reads it) */
+	for (i = 0; i < RADIO_GROUPS; i++) {
+		if (!radio->group[i]) {
+			sreg = SREG;
+			cli();
+			radio->group[i] = group;
+			SREG = sreg;
+			
+			return ERR_OK;
+		}
+	}
+	
+	return ERR_BUSY;
+#else
+	return ERR_CONFIG;
+#endif
+}
+
+int radio433_leave(struct radio_data_s *radio, uint16_t group)
+{
+#if RADIO_GROUPS > 0
+	uint8_t i, sreg;
+	
+	for (i = 0; i < RADIO_GROUPS; i++) {
+		if (group && radio->group[i] == group) {
+			sreg = SREG;
+			cli();
+			radio->group[i] = 0;
+			SREG = sreg;
+			
+			return ERR_OK;
+		}
+	}
+#endif
+	
+	return ERR_CONFIG;
+}
+
 int radio433_send(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data, uint8_t payload)
+{
+	return radio433_sendprio(radio, dst_addr, data, payload, PRIO_LOW);
+}
+
+int radio433_sendprio(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data, uint8_t payload, uint8_t prio)
+{
+	struct transport_s hdr;
+	
+	memset(&hdr, 0, sizeof(struct transport_s));
+	hdr.dst_addr = dst_addr;
+	
+	return radio433_sendpkt(radio, &hdr, data, payload, prio);
+}
+
+int radio433_sendpkt(struct radio_data_s *radio, struct transport_s *hdr, uint8_t *data, uint8_t payload, uint8_t prio)
 {
 	uint8_t buf[MAX_FRAME_SIZE];
-	struct transport_s *const hdr = (struct transport_s *)buf;
 	uint16_t *crc;
 	int rval;
 	
@@ -444,8 +1854,8 @@ int radio433_send(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data,
 		payload = MAX_DATA_SIZE;
 	
 	/* fill transport header and copy data */
-	hdr->dst_addr = dst_addr;
 	hdr->src_addr = radio->address;
+	memcpy(buf, hdr, sizeof(struct transport_s));
 	memcpy(buf + sizeof(struct transport_s), data, payload);
 	
 	/* calculate CRC and put it in place */
@@ -453,43 +1863,113 @@ int radio433_send(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data,
 	*crc = crc16ccitt(buf, sizeof(struct transport_s) + payload);
 	
 	/* send data frame (headers + payload + CRC) */
-	rval = radio433_tx(radio, buf, sizeof(struct transport_s) + payload + 2);
+	rval = radio433_txprio(radio, buf, sizeof(struct transport_s) + payload + 2, prio);
 	
 	return rval;
 }
 
 int radio433_recv(struct radio_data_s *radio, uint16_t *src_addr, uint8_t *data, uint8_t *payload)
 {
-	uint8_t buf[MAX_FRAME_SIZE], size;
-	struct transport_s *const hdr = (struct transport_s *)buf;
-	uint16_t *crc;
+	struct transport_s hdr;
 	int rval;
+	
+	do {
+		rval = radio433_recvpkt(radio, &hdr, data, payload);
+		
+		if (rval != ERR_OK)
+			return rval;
+#if RADIO_ARQ == 1
+	/* reliable transport frames are handled by radio433_arq_recv() */
+	} while (hdr.flags);
+#else
+	} while (0);
+#endif
+	
+	*src_addr = hdr.src_addr;
+	
+	return ERR_OK;
+}
 
-	if (!radio->address)
-		return ERR_CONFIG;
+int radio433_recvpkt(struct radio_data_s *radio, struct transport_s *hdr, uint8_t *data, uint8_t *payload)
+{
+	volatile struct radio_frame_s *slot;
+	int rval;
+	
+	rval = radio433_pktslot(radio, hdr, &slot);
+	if (rval != ERR_OK)
+		return rval;
+	
+	/* we are set, copy data (straight from the slot) */
+	*payload = slot->payload - sizeof(struct transport_s) - 2;
+	memcpy(data, (char *)slot->data + sizeof(struct transport_s), *payload);
+#if RADIO_STAMPS == 1
+	radio433_rxdone(radio, slot);
+#endif
+	radio->head++;
+	
+	return ERR_OK;
+}
 
+int radio433_acquire(struct radio_data_s *radio, uint16_t *src_addr, uint8_t **data, uint8_t *payload)
+{
+	volatile struct radio_frame_s *slot;
+	struct transport_s hdr;
+	int rval;
+	
 	do {
-		/* try to receive a frame */
-		rval = radio433_rx(radio, buf, &size);
-		
-		/* no data or something weird happened */
+		rval = radio433_pktslot(radio, &hdr, &slot);
 		if (rval != ERR_OK)
 			return rval;
-		
-		crc = (uint16_t *)(buf + size - 2);
-		
-	/* check if this data is for us (this address or broadcast) */
-	} while (hdr->dst_addr != radio->address && hdr->dst_addr != BCAST_ADDR);
+#if RADIO_ARQ == 1
+		/* reliable transport frames are handled by radio433_arq_recv() */
+		if (hdr.flags) {
+			radio->head++;
+			continue;
+		}
+#endif
+		break;
+	} while (1);
+	
+	/* lend the slot: the payload stays in place until released, and
+	 * the RX ring has one slot less meanwhile */
+	*src_addr = hdr.src_addr;
+	*data = (uint8_t *)slot->data + sizeof(struct transport_s);
+	*payload = slot->payload - sizeof(struct transport_s) - 2;
+#if RADIO_STAMPS == 1
+	radio433_rxdone(radio, slot);
+#endif
+	radio->lent = 1;
+	
+	return ERR_OK;
+}
+
+int radio433_release(struct radio_data_s *radio)
+{
+	if (!radio->lent)
+		return ERR_CONFIG;
+	
+	radio->lent = 0;
+	radio->head++;
+	
+	return ERR_OK;
+}
+
+int radio433_handler(struct radio_data_s *radio,
+	void (*handler)(struct radio_data_s *radio, uint16_t src_addr, uint8_t *data, uint8_t payload))
+{
+#if RADIO_CALLBACK == 1
+	/* packets need an address (and a receiver) */
+	if ((radio->direction != RX && !radio->duplex) || !radio->address)
+		return ERR_CONFIG;
+	
+	/* packets go to the handler from now on (or back to polling with
+	 * radio433_recv(), without one) */
+	cli();
+	radio->handler = handler;
+	sei();
 	
-	/* check CRC */
-	if (crc16ccitt(buf, size - 2) != *crc)
-		return ERR_CRC_ERROR;
-		
-	/* we are set, copy data */
-	*src_addr = hdr->src_addr;
-	*payload = size - sizeof(struct transport_s) - 2;
-	memcpy(data, buf + sizeof(struct transport_s),
-		size - sizeof(struct transport_s) - 2);
-		
 	return ERR_OK;
+#else
+	return ERR_CONFIG;
+#endif
 }
@@ -1,62 +1,344 @@
+/* default pins used by radio433_setup(), other pins can be bound with
+ * radio433_attach(). input (PIN) and direction (DDR) registers are found
+ * right below the PORT register */
 #define TX_PORT			PORTC
-#define TX_DIR			DDRC
 #define TX_PIN			PC2
-#define RX_PORT			PINC
-#define RX_DIR			DDRC
+#define RX_PORT			PORTC
 #define RX_PIN			PC3
 
-#define ENCODE4B5B		1
+/* timer backends compiled in. timer0 is also used by servo0, timer1
+ * by the DC motor and servo1 drivers. radio433_setup() uses RADIO_TIMER */
+#define USE_TIMER0		0
+#define USE_TIMER1		0
+#define USE_TIMER2		1
+#define RADIO_TIMER		RADIO_TIMER2
+
+#ifdef RADIO_SIM
+/* host build (sim/), all timers are simulated */
+#undef USE_TIMER0
+#undef USE_TIMER1
+#undef USE_TIMER2
+#define USE_TIMER0		1
+#define USE_TIMER1		1
+#define USE_TIMER2		1
+#endif
+
+/* edge timestamped RX: word sync is found by a pin change interrupt on
+ * the RX pin instead of busy waiting inside the timer ISR (not available
+ * on the ATmega8). pin change mask and vector depend on RX_PORT */
+#define RX_EDGE			0
+#define RX_PCMSK		PCMSK1
+#define RX_PCIE			PCIE1
+#define RX_PCIF			PCIF1
+#define RX_PCINT_vect		PCINT1_vect
+#define EDGE_TIMEOUT		3			// bit periods to wait for a word sync edge
+
+/* automatic baud rate detection (radio433_autobaud(), requires RX_EDGE).
+ * between frames the timer runs at AUTOBAUD_HUNT and the pin change
+ * interrupt measures the training strobe bit period. radio433_ticks()
+ * counts bit periods of the last rate locked to, even while hunting */
+#define RADIO_AUTOBAUD		0
+#define AUTOBAUD_HUNT		5000			// timer rate while hunting, the highest supported rate
+#define AUTOBAUD_EDGES		8			// strobe bit periods measured before locking
+#define AUTOBAUD_WAIT		(TSTROBE + TSYNC + TNETWORK)	// bit periods to find a sync after locking
+
+/* majority vote RX: each data bit is decided by RX_SAMPLES (1, 3 or 5)
+ * samples, 1/16th of a bit period apart and centred on the sample point.
+ * the samples are taken in a busy wait inside the timer ISR, which holds
+ * every other interrupt back for (RX_SAMPLES - 1) / 16 of a bit period
+ * (250us at 1000 bps with 5 samples). radio433_attach() refuses radios
+ * when the bursts of the RX radios would take more than 1/4 of the bit
+ * period of any other radio: with 5 samples, two RX radios at the same
+ * rate or a RX radio and a TX one no faster than it, with 3 samples up
+ * to three radios at the same rate. an autobaud radio that votes must be
+ * the only radio */
+#define RX_SAMPLES		1
+
+#define RADIO_CODING		CODING_4B5B		// line coding of data words, radio433_coding() selects another one
+#define RADIO_FEC		0			// extended hamming (8,4) code words instead of 4b5b
+#define SYNC_TOLERANCE		1			// wrong strobe tail and sync bits accepted by the sync correlator
+#define SYNC_NETWORK		0			// network sync word after the sync pattern (radio433_network())
+#define RX_TOLERANCE		0			// bad data words (start bits or symbols) tolerated in a frame, without RS
+#define RX_FILTER		0			// drop packets for other addresses in the RX FSM, right after their address
+#define FILTER_SKIP		1			// 1: wait for the end of a dropped frame, 0: hunt for a sync right away
+#define RADIO_GROUPS		2			// group addresses a radio may join, besides its own (radio433_join())
+#define RADIO_RS		0			// reed-solomon outer code over each frame (lib/rs.c)
+#define RS_PARITY		8			// RS parity bytes appended to each frame on the air
 #define MAX_FRAME_SIZE		40			// 32 bytes for user data + 8 bytes for length, address, options, CRC...
 #define MAX_DATA_SIZE		32			// 32 bytes for user data
+#define RX_SLOTS		2			// frames buffered by the RX FSM (power of 2)
+#define TXQ_SLOTS		2			// frames queued for TX per priority (power of 2)
+#define TX_PRIOS		2			// TX queue priority levels
+#define TTURN			4			// half duplex turnaround time (bit periods)
+#define TIDLE			64			// half duplex, bit periods in a row with no frame on air before sending low priority frames
+#define TREPLY			1024			// half duplex, bit periods a reply (radio433_reply()) waits for the frame it answers
+#define RADIO_BURST		0			// send queued frames back to back, under a single strobe and sync
+#define BURST_FRAMES		4			// most frames in a burst
+#define RADIO_ARQ		0			// sequence numbers and flags in the transport header (arq.c)
+#define RADIO_FRAG		0			// fragmentation and reassembly of large messages (frag.c)
+#define RADIO_CALLBACK		0			// packets handed to a handler at the end of the RX ISR (radio433_handler())
+#define RADIO_STAMPS		0			// per frame timestamps, in bit periods of the radio time base
+#define RADIO_HIST		0			// queueing and air time histograms (needs RADIO_STAMPS)
+#define HIST_BINS		10			// histogram bins: 0-1, 2-3, 4-7 ... bit periods
 
-#if ENCODE4B5B == 0
-#define TSTROBE			20			// training preamble strobe length
-#define TSYNC			10			// half period high, half low
-#define TBYTE			10			// period for 1 byte using raw coding
-#define TLEADOUT		10			// period of silence
-#else
+#if RADIO_HIST == 1 && RADIO_STAMPS == 0
+#error "RADIO_HIST needs RADIO_STAMPS"
+#endif
+
+/* strobe, sync and the frame length word (always 4b5b) are the same for
+ * all codings, and the length word tells the receiver the coding of the
+ * data words. the leadout is as long as a data word (as a length word
+ * with RADIO_BURST, as it may be the length word of the next frame) */
 #define TSTROBE			24			// training preamble strobe length
 #define TSYNC			12			// half period high, half low
-#define TBYTE			12			// period for 1 byte using 4b5b coding
-#define TLEADOUT		12			// period of silence
+#define THEADER			12			// frame length and coding word
+#if SYNC_NETWORK == 1
+#define TNETWORK		10			// network id (always 4b5b)
+#else
+#define TNETWORK		0
+#endif
+#define TBYTE_RAW		10			// period for 1 byte using raw or scrambled NRZ coding
+#define TBYTE_4B5B		12			// period for 1 byte using 4b5b coding
+#define TBYTE_MANCHESTER	18			// period for 1 byte using manchester coding
+#define TBYTE_FEC		18			// period for 1 byte using two hamming (8,4) code words
+#define TBYTE_MAX		18
+
+/* largest frame on the air, including RS parity */
+#if RADIO_RS == 1
+#define AIR_FRAME_SIZE		(MAX_FRAME_SIZE + RS_PARITY)
+#else
+#define AIR_FRAME_SIZE		MAX_FRAME_SIZE
 #endif
 
+/* worst case frame length (in bits) and the size of the packed bit
+ * stream of a queued frame, shifted out by the TX FSM */
+#define TFRAME			(TSTROBE + TSYNC + TNETWORK + THEADER + TBYTE_MAX * (AIR_FRAME_SIZE + 1))
+#define STREAM_SIZE		((TFRAME + 7) >> 3)
+
 #define ERR_OK			0
 #define ERR_NO_DATA		-1
 #define ERR_BUSY		-2
 #define ERR_FRAME_ERROR		-3
 #define ERR_CRC_ERROR		-4
 #define ERR_CONFIG		-5
+#define ERR_INCOMPLETE		-6
 
 enum radio_state {
-	READY, START, STROBE, SYNC, PAYLOAD, DATA, LEADOUT, RECV, ERROR
+	READY, START, STROBE, SYNC, PAYLOAD, DATA, LEADOUT, RECV, ERROR, TURN, BAUD, SKIP
 };
 
 enum radio_dir {
 	NONE, TX, RX
 };
 
+enum radio_timer {
+	RADIO_TIMER0, RADIO_TIMER1, RADIO_TIMER2, RADIO_TIMERS
+};
+
+enum radio_prio {
+	PRIO_LOW, PRIO_HIGH
+};
+
+enum radio_coding {
+	CODING_4B5B, CODING_RAW, CODING_MANCHESTER, CODING_SCRAMBLED, CODINGS
+};
+
+enum frame_status {
+	FRAME_OK, FRAME_ERROR
+};
+
+/* timestamps of a frame (radio433_ticks() time base). TX frames are
+ * queued, start and end on the air, RX frames start right after the
+ * sync (the length word, inside a burst), end with the leadout and are
+ * dequeued by the application */
+struct radio_stamp_s {
+	uint16_t queued;		// TX: queued by radio433_tx()
+	uint16_t start;			// TX: first bit sent, RX: sync found
+	uint16_t end;			// TX: last bit sent, RX: frame complete
+	uint16_t dequeued;		// RX: taken by radio433_rx()
+};
+
+/* log2 histograms of queueing time (TX queue to air, or RX ring to
+ * application) and air time, in bit periods. bin n counts the frames
+ * that took 2^n to 2^(n+1) - 1 bit periods, the last one longer ones */
+struct radio_hist_s {
+	uint16_t txqueue[HIST_BINS];
+	uint16_t txair[HIST_BINS];
+	uint16_t rxair[HIST_BINS];
+	uint16_t rxqueue[HIST_BINS];
+};
+
+struct radio_frame_s {
+	uint8_t data[AIR_FRAME_SIZE];
+	uint8_t payload;
+	uint8_t status;
+	uint16_t crc;
+#if RADIO_RS == 1
+	uint8_t erasures;
+	uint8_t erasure[RS_PARITY];
+#endif
+#if RADIO_STAMPS == 1
+	struct radio_stamp_s stamp;
+#endif
+};
+
+/* a frame in the TX queue, rendered (RS parity and line coding
+ * included) when it is queued */
+struct radio_txframe_s {
+	uint8_t stream[STREAM_SIZE];
+	uint16_t bits;
+#if RADIO_STAMPS == 1
+	uint16_t queued;
+#endif
+};
+
+/* frame storage, provided by the application for the side(s) a radio
+ * uses: the RX ring (RX and half duplex) and the TX queues (TX and half
+ * duplex). the frame on the air keeps its slot until it is out */
+struct radio_rxbuf_s {
+	volatile struct radio_frame_s slot[RX_SLOTS];
+};
+
+struct radio_txbuf_s {
+	volatile struct radio_txframe_s txq[TX_PRIOS][TXQ_SLOTS];
+};
+
+/* link statistics, updated by the FSM (ISR) and the API. a snapshot is
+ * taken (and the counters reset) with radio433_stats() */
+struct radio_stats_s {
+	uint16_t syncs;			// sync patterns found
+	uint16_t frames;		// frames received
+	uint16_t length_errors;		// frames with a bad length word
+	uint16_t frame_errors;		// frames lost to bad data words or word sync
+	uint16_t framing_errors;	// of those, aborted on bad word start bits
+	uint16_t symbol_errors;		// of those, aborted on invalid code words
+	uint16_t crc_errors;		// packets with a bad CRC
+	uint16_t overruns;		// frames dropped, RX ring full
+	uint16_t filtered;		// packets for other addresses
+	uint16_t corrected;		// bits (FEC) and bytes (RS) corrected
+	uint16_t sent;			// frames sent
+	uint16_t busy;			// frames refused, TX queue full
+};
+
 struct radio_data_s {
-	volatile uint8_t data[MAX_FRAME_SIZE];
+	struct radio_rxbuf_s *rxbuf;
+	struct radio_txbuf_s *txbuf;
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	volatile uint8_t lent;
+	volatile struct radio_stats_s stats;
+	volatile uint8_t txhead[TX_PRIOS];
+	volatile uint8_t txtail[TX_PRIOS];
+	volatile uint8_t txprio;
+	volatile uint8_t *volatile sptr;
+	volatile uint16_t sbits;
+	volatile uint8_t smask;
 	volatile uint8_t payload;
 	volatile uint8_t pcount;
 	volatile uint8_t tbit;
 	volatile uint8_t state;
 	volatile uint8_t direction;
+	volatile uint8_t edge;
+	volatile uint8_t rxcoding;
+	volatile uint8_t rxbad;
+	volatile uint8_t rxviol;
+#if RADIO_BURST == 1
+	volatile uint8_t rxburst;
+#endif
+	volatile uint8_t tbyte;
+	volatile uint8_t lfsr;
+	volatile uint16_t ticks;
+	volatile uint8_t idle;
+	volatile uint16_t reply;
+	volatile uint16_t rfdata;
+	volatile uint32_t corr;
+#if RX_FILTER == 1
+	volatile uint16_t skip;
+#endif
+#if RADIO_BURST == 1
+	volatile uint16_t tword;
+	volatile uint8_t burst;
+#endif
+#if RADIO_STAMPS == 1
+	volatile struct radio_stamp_s txcur;
+	volatile struct radio_stamp_s txstamp;
+	volatile struct radio_stamp_s rxstamp;
+#endif
+#if RADIO_HIST == 1
+	volatile struct radio_hist_s hist;
+#endif
+	volatile uint8_t *txport;
+	volatile uint8_t *rxport;
+	uint8_t txmask;
+	uint8_t rxmask;
+	uint8_t duplex;
+	uint8_t coding;
+#if SYNC_NETWORK == 1
+	uint8_t network;
+	uint32_t sync;
+#endif
+#if RADIO_AUTOBAUD == 1
+	uint8_t autobaud;
+	volatile uint8_t ablevel;
+	volatile uint8_t abedges;
+	volatile uint8_t ablock;
+	volatile uint16_t abticks;
+	volatile uint16_t abfrac;
+	volatile uint32_t abstamp;
+	volatile uint32_t abfirst;
+	volatile uint32_t absum;
+#endif
+#if RADIO_CALLBACK == 1
+	void (*handler)(struct radio_data_s *radio, uint16_t src_addr, uint8_t *data, uint8_t payload);
+	volatile uint8_t dispatch;
+#endif
+	uint8_t timer;
+	uint16_t baud;
 	uint16_t address;
+#if RADIO_GROUPS > 0
+	uint16_t group[RADIO_GROUPS];
+#endif
 };
 
-int radio433_setup(struct radio_data_s *radio, uint16_t baud, uint8_t direction);
+int radio433_setup(struct radio_data_s *radio, struct radio_rxbuf_s *rxbuf, struct radio_txbuf_s *txbuf,
+	uint16_t baud, uint8_t direction);
+int radio433_attach(struct radio_data_s *radio, struct radio_rxbuf_s *rxbuf, struct radio_txbuf_s *txbuf,
+	uint16_t baud, uint8_t direction, uint8_t timer, volatile uint8_t *port, uint8_t pin);
+int radio433_dettach(struct radio_data_s *radio);
+int radio433_halfduplex(struct radio_data_s *radio, volatile uint8_t *port, uint8_t pin);
+int radio433_coding(struct radio_data_s *radio, uint8_t coding);
+int radio433_autobaud(struct radio_data_s *radio);
+int radio433_network(struct radio_data_s *radio, uint8_t network);
+void radio433_stats(struct radio_data_s *radio, struct radio_stats_s *stats, uint8_t reset);
+int radio433_txstamp(struct radio_data_s *radio, struct radio_stamp_s *stamp);
+int radio433_rxstamp(struct radio_data_s *radio, struct radio_stamp_s *stamp);
+int radio433_hist(struct radio_data_s *radio, struct radio_hist_s *hist, uint8_t reset);
 int radio433_tx(struct radio_data_s *radio, uint8_t *data, uint8_t payload);
+int radio433_txprio(struct radio_data_s *radio, uint8_t *data, uint8_t payload, uint8_t prio);
+int radio433_reply(struct radio_data_s *radio, uint8_t *data, uint8_t payload);
 int radio433_rx(struct radio_data_s *radio, uint8_t *data, uint8_t *payload);
+uint16_t radio433_ticks(struct radio_data_s *radio);
 
 #define BCAST_ADDR		0xffff
 
 struct transport_s {
 	uint16_t dst_addr;
 	uint16_t src_addr;
+#if RADIO_ARQ == 1
+	uint8_t seq;
+	uint8_t flags;
+#endif
 };
 
 void radio433_addr(struct radio_data_s *radio, uint16_t address);
+int radio433_join(struct radio_data_s *radio, uint16_t group);
+int radio433_leave(struct radio_data_s *radio, uint16_t group);
 int radio433_send(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data, uint8_t payload);
+int radio433_sendprio(struct radio_data_s *radio, uint16_t dst_addr, uint8_t *data, uint8_t payload, uint8_t prio);
 int radio433_recv(struct radio_data_s *radio, uint16_t *src_addr, uint8_t *data, uint8_t *payload);
+int radio433_sendpkt(struct radio_data_s *radio, struct transport_s *hdr, uint8_t *data, uint8_t payload, uint8_t prio);
+int radio433_recvpkt(struct radio_data_s *radio, struct transport_s *hdr, uint8_t *data, uint8_t *payload);
+int radio433_acquire(struct radio_data_s *radio, uint16_t *src_addr, uint8_t **data, uint8_t *payload);
+int radio433_release(struct radio_data_s *radio);
+int radio433_handler(struct radio_data_s *radio,
+	void (*handler)(struct radio_data_s *radio, uint16_t src_addr, uint8_t *data, uint8_t payload));
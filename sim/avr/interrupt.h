@@ -0,0 +1,7 @@
+/* host build: interrupt handlers are plain functions, called by the
+ * simulator (hal_sim.c) in time order */
+
+#define ISR(vector)		void vector(void); void vector(void)
+
+#define sei()			(SREG |= 0x80)
+#define cli()			(SREG &= ~0x80)
@@ -0,0 +1,25 @@
+/* host build: the AVR I/O registers used by the radio433 sources, as
+ * plain memory (hal_sim.c). timers are simulated behind the HAL */
+
+#include <stdint.h>
+
+/* PIN, DDR and PORT registers, in the AVR order */
+extern volatile uint8_t sim_io[];
+
+#define PINB			sim_io[0x03]
+#define DDRB			sim_io[0x04]
+#define PORTB			sim_io[0x05]
+#define PINC			sim_io[0x06]
+#define DDRC			sim_io[0x07]
+#define PORTC			sim_io[0x08]
+#define PIND			sim_io[0x09]
+#define DDRD			sim_io[0x0a]
+#define PORTD			sim_io[0x0b]
+
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2, SREG;
+
+enum {PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7};
+enum {PC0, PC1, PC2, PC3, PC4, PC5, PC6};
+enum {PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7};
+enum {PCIE0, PCIE1, PCIE2};
+enum {PCIF0, PCIF1, PCIF2};
@@ -0,0 +1,389 @@
+/* file:          hal_sim.c
+ * description:   radio433 hardware access for host builds, simulated
+ *                timers and RF channel
+ * version:       v0.01
+ * date:          01/2025
+ * author:        Sergio Johann Filho <sergiojohannfilho@gmail.com>
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <radio433.h>
+#include <hal.h>
+#include "sim.h"
+
+/*
+each radio is bound to a timer, as on the AVR, and each one is taken
+as a node of its own (another MCU, with its own clock and drift). timer
+compare matches and pin changes are events on a common time line (ns),
+handled in order by the ISRs of the radio433 sources.
+
+the TX pin of the sender drives a virtual wire to each receiver. the
+channel of each receiver flips the level of bit periods at random (bit
+error rate, with noise bursts from a two state Gilbert-Elliott model)
+and delays edges by a propagation delay and jitter.
+
+busy waits inside the ISRs (RX pin and timer count reads) move time
+forward, so the other nodes keep going meanwhile. each node inside an
+ISR has a clock of its own: its reads only move that clock, and the
+ISRs of other nodes that run meanwhile (up to that time) move theirs,
+so a node is never held back by the time another one spends in its
+ISRs. edges carry the time they show up on a pin, so a node reads the
+level its wire had at its own time.
+*/
+
+#define SIM_EDGES		64			// edges in flight on each wire
+#define SIM_POLL		250.0			// time taken by a pin or timer read (ns)
+
+enum sim_event {
+	SIM_NONE, SIM_TIMER, SIM_EDGE
+};
+
+struct sim_edge_s {
+	double time;
+	uint8_t level;
+};
+
+struct sim_node_s {
+	struct radio_data_s *radio;
+	double clock;			// clock period scale (drift)
+	uint16_t prescaler;
+	uint16_t top;
+	double start;			// time of count 0
+	double next;			// time of the next compare match
+	uint8_t running;
+	uint8_t busy;			// in one of its ISRs
+	double time;			// its own clock, while busy
+	struct sim_channel_s channel;
+	struct sim_edge_s edge[SIM_EDGES];
+	uint8_t head;
+	uint8_t tail;
+	uint8_t level;			// RX pin level
+	uint8_t sent;			// last level on the wire
+	double last;			// time of the last edge on the wire
+	uint8_t burst;			// in a noise burst
+};
+
+volatile uint8_t sim_io[0x10];
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2, SREG;
+
+void TIMER0_COMPA_vect(void);
+void TIMER1_COMPA_vect(void);
+void TIMER2_COMPA_vect(void);
+#if RX_EDGE == 1
+void RX_PCINT_vect(void);
+#endif
+
+static struct sim_node_s nodes[RADIO_TIMERS];
+static struct sim_node_s *current;		// the node whose ISR is running
+static double now;				// time of the main program
+static uint32_t seed;
+
+static void sim_advance(double until);
+
+static double sim_random(void)
+{
+	/* xorshift, so runs are the same on any host */
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	
+	return (double)seed / 4294967296.0;
+}
+
+static double sim_now(void)
+{
+	/* time as seen by the code running: an ISR or the main program */
+	return current ? current->time : now;
+}
+
+static void sim_poll(void)
+{
+	/* a pin or timer read takes a while, other nodes go on */
+	if (current) {
+		current->time += SIM_POLL;
+		sim_advance(current->time);
+	} else {
+		sim_advance(now + SIM_POLL);
+	}
+}
+
+static double sim_count(struct sim_node_s *node)
+{
+	/* length of a timer count (ns) */
+	return node->prescaler * 1e9 / F_CPU * node->clock;
+}
+
+static struct sim_node_s *sim_rx(volatile uint8_t *port, uint8_t mask)
+{
+	uint8_t i;
+	
+	for (i = 0; i < RADIO_TIMERS; i++)
+		if (nodes[i].radio && nodes[i].radio->rxport == port && nodes[i].radio->rxmask == mask)
+			return &nodes[i];
+	
+	return 0;
+}
+
+static void sim_push(struct sim_node_s *node, double time, uint8_t level)
+{
+	/* no room, the oldest edge is gone (and the RX pin follows it) */
+	if ((uint8_t)(node->tail - node->head) >= SIM_EDGES)
+		node->level = node->edge[node->head++ % SIM_EDGES].level;
+	
+	/* jitter must not reorder edges */
+	if (time < node->last)
+		time = node->last;
+	node->edge[node->tail % SIM_EDGES].time = time;
+	node->edge[node->tail % SIM_EDGES].level = level;
+	node->tail++;
+	node->last = time;
+	node->sent = level;
+}
+
+static void sim_wire(struct sim_node_s *tx)
+{
+	struct sim_node_s *rx;
+	struct sim_channel_s *ch;
+	uint8_t i, level;
+	double ber;
+	
+	/* the level of the TX pin for this bit period, as seen by each
+	 * receiver */
+	for (i = 0; i < RADIO_TIMERS; i++) {
+		rx = &nodes[i];
+		if (!rx->radio || rx->radio->direction != RX)
+			continue;
+		
+		ch = &rx->channel;
+		if (rx->burst) {
+			if (sim_random() * ch->burst_len < 1.0)
+				rx->burst = 0;
+		} else {
+			if (sim_random() < ch->burst_rate)
+				rx->burst = 1;
+		}
+		ber = rx->burst ? ch->burst_ber : ch->ber;
+		
+		level = (*tx->radio->txport & tx->radio->txmask) ? 1 : 0;
+		if (sim_random() < ber)
+			level ^= 1;
+		if (level != rx->sent)
+			sim_push(rx, tx->time + (ch->delay + (2.0 * sim_random() - 1.0) * ch->jitter) * 1000.0, level);
+	}
+}
+
+static void sim_isr(uint8_t timer)
+{
+	switch (timer) {
+	case RADIO_TIMER0:
+		TIMER0_COMPA_vect();
+		break;
+	case RADIO_TIMER1:
+		TIMER1_COMPA_vect();
+		break;
+	case RADIO_TIMER2:
+		TIMER2_COMPA_vect();
+		break;
+	}
+}
+
+static struct sim_node_s *sim_next(double *time, uint8_t *event)
+{
+	struct sim_node_s *node, *next = 0;
+	uint8_t i;
+	
+	/* the earliest event of the nodes that are not inside an ISR */
+	*event = SIM_NONE;
+	for (i = 0; i < RADIO_TIMERS; i++) {
+		node = &nodes[i];
+		if (node->busy)
+			continue;
+		
+		if (node->running && (!next || node->next < *time)) {
+			next = node;
+			*time = node->next;
+			*event = SIM_TIMER;
+		}
+#if RX_EDGE == 1
+		/* edges are events while the pin change interrupt is on */
+		if (node->radio && (RX_PCMSK & node->radio->rxmask) && node->head != node->tail &&
+		    (!next || node->edge[node->head % SIM_EDGES].time < *time)) {
+			next = node;
+			*time = node->edge[node->head % SIM_EDGES].time;
+			*event = SIM_EDGE;
+		}
+#endif
+	}
+	
+	return next;
+}
+
+static void sim_advance(double until)
+{
+	struct sim_node_s *node;
+	double time;
+	uint8_t event;
+	
+	struct sim_node_s *caller;
+	
+	/* handle events up to this time. this is also called from the
+	 * busy waits inside ISRs, so other nodes keep running. each ISR
+	 * runs on the clock of its node, starting at the event time */
+	while ((node = sim_next(&time, &event)) && time <= until) {
+		if (!current && time > now)
+			now = time;
+		caller = current;
+		current = node;
+		node->busy = 1;
+		node->time = time;
+		if (event == SIM_TIMER) {
+			node->start = node->next;
+			node->next += (node->top + 1) * sim_count(node);
+			sim_isr(node - nodes);
+			if (node->radio && node->radio->direction == TX)
+				sim_wire(node);
+		} else {
+			node->level = node->edge[node->head++ % SIM_EDGES].level;
+#if RX_EDGE == 1
+			RX_PCINT_vect();
+#endif
+		}
+		node->busy = 0;
+		current = caller;
+	}
+	
+	if (!current && until > now)
+		now = until;
+}
+
+uint8_t hal_pin_read(volatile uint8_t *port, uint8_t mask)
+{
+	struct sim_node_s *node;
+	
+	sim_poll();
+	
+	node = sim_rx(port, mask);
+	if (!node)
+		return 0;
+	
+	while (node->head != node->tail && node->edge[node->head % SIM_EDGES].time <= sim_now())
+		node->level = node->edge[node->head++ % SIM_EDGES].level;
+	
+	return node->level ? mask : 0;
+}
+
+int hal_timer_start(uint8_t timer, uint16_t baud)
+{
+	struct sim_node_s *node;
+	
+	if (timer >= RADIO_TIMERS)
+		return ERR_CONFIG;
+	
+	/* the same prescalers and compare values as the AVR timers */
+	node = &nodes[timer];
+	if (timer == RADIO_TIMER1)
+		node->prescaler = 8;
+	else if (baud >= 1000)
+		node->prescaler = 64;
+	else if (baud >= 250)
+		node->prescaler = 256;
+	else
+		node->prescaler = 1024;
+	node->top = ((F_CPU / node->prescaler) / baud) - 1;
+	node->start = sim_now();
+	node->next = node->start + (node->top + 1) * sim_count(node);
+	node->running = 1;
+	
+	return ERR_OK;
+}
+
+void hal_timer_stop(uint8_t timer)
+{
+	if (timer < RADIO_TIMERS)
+		nodes[timer].running = 0;
+}
+
+void hal_timer_rephase(uint8_t timer, uint16_t count)
+{
+	struct sim_node_s *node = &nodes[timer];
+	uint32_t phase;
+	
+	/* as on the AVR, the count moves ahead from where it was at the
+	 * edge and a compare match that is already pending is dropped */
+	phase = (uint32_t)((sim_now() - node->start) / sim_count(node)) % (node->top + 1);
+	if (phase < count)
+		phase += node->top + 1;
+	phase = phase - count + (node->top >> 3) + RX_BURST(node->top);
+	if (phase > node->top)
+		phase = node->top;
+	node->start = sim_now() - phase * sim_count(node);
+	node->next = node->start + (node->top + 1) * sim_count(node);
+}
+
+uint16_t hal_timer_count(uint8_t timer, uint16_t *top)
+{
+	struct sim_node_s *node = &nodes[timer];
+	
+	sim_poll();
+	
+	*top = node->top;
+	
+	return (uint32_t)((sim_now() - node->start) / sim_count(node)) % (node->top + 1);
+}
+
+uint8_t hal_timer_pending(uint8_t timer)
+{
+	return nodes[timer].running && sim_now() >= nodes[timer].next;
+}
+
+void sim_init(uint32_t value)
+{
+	uint8_t i;
+	
+	/* before radio433_attach(), as it starts the timers */
+	memset(nodes, 0, sizeof(nodes));
+	for (i = 0; i < RADIO_TIMERS; i++)
+		nodes[i].clock = 1.0;
+	current = 0;
+	now = 0;
+	seed = value ? value : 1;
+}
+
+int sim_node(struct radio_data_s *radio, double drift)
+{
+	struct sim_node_s *node;
+	
+	if (radio->timer >= RADIO_TIMERS)
+		return ERR_CONFIG;
+	
+	/* the clock of this node is off by drift ppm */
+	node = &nodes[radio->timer];
+	node->radio = radio;
+	node->clock = 1.0 + drift * 1e-6;
+	node->next = node->start + (node->top + 1) * sim_count(node);
+	
+	return ERR_OK;
+}
+
+int sim_channel(struct radio_data_s *radio, struct sim_channel_s *channel)
+{
+	if (radio->timer >= RADIO_TIMERS || nodes[radio->timer].radio != radio)
+		return ERR_CONFIG;
+	
+	nodes[radio->timer].channel = *channel;
+	
+	return ERR_OK;
+}
+
+void sim_run(double ms)
+{
+	sim_advance(now + ms * 1e6);
+}
+
+double sim_time(void)
+{
+	return now / 1e6;
+}
@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include "sim.h"
+
+/* radiosim: packet error rate and throughput of a radio433 link. a
+ * sender queues packets to one or two receivers, over simulated timers
+ * and RF channel, and each receiver checks what arrives */
+
+#define TX_ADDR			0x5150
+#define RX_ADDR			0x1234
+#define DRAIN_BITS		(THEADER + 2 * TBYTE_MAX)	// after the last frame is out, for the leadout and receivers
+
+struct rx_result_s {
+	int ok;
+	int bad;
+	int errors;
+};
+
+static void usage(char *name)
+{
+	printf("usage: %s [options]\n"
+		"  -b baud        baud rate (1000)\n"
+		"  -c coding      0: 4b5b, 1: raw, 2: manchester, 3: scrambled (0)\n"
+		"  -l bytes       packet payload (16)\n"
+		"  -n packets     packets sent (1000)\n"
+		"  -g ms          gap between packets, 0 for back to back (0)\n"
+		"  -r receivers   1 or 2 (1)\n"
+		"  -e ber         bit error rate (0)\n"
+		"  -u rate        chance of a noise burst, per bit (0)\n"
+		"  -U bits        average noise burst length (16)\n"
+		"  -E ber         bit error rate in a noise burst (0.5)\n"
+		"  -d ppm         receiver clock drift, the second one is -ppm (0)\n"
+		"  -D us          propagation delay (0)\n"
+		"  -j us          propagation jitter, plus or minus (0)\n"
+		"  -s seed        random seed (1)\n", name);
+	exit(1);
+}
+
+static void fill(uint8_t *data, uint8_t size, uint16_t seq)
+{
+	uint8_t i;
+	
+	data[0] = seq >> 8;
+	data[1] = seq & 0xff;
+	for (i = 2; i < size; i++)
+		data[i] = seq * 7 + i;
+}
+
+static int check(uint8_t *data, uint8_t size, uint8_t expect)
+{
+	uint8_t buf[MAX_DATA_SIZE];
+	
+	if (size != expect || size < 2)
+		return 0;
+	fill(buf, size, (data[0] << 8) | data[1]);
+	
+	return !memcmp(buf, data, size);
+}
+
+int main(int argc, char **argv)
+{
+	static struct radio_data_s tx, rx[2];
+	static struct radio_txbuf_s txbuf;
+	static struct radio_rxbuf_s rxbuf[2];
+	struct rx_result_s result[2];
+	struct sim_channel_s channel;
+	struct radio_stats_s stats;
+	uint8_t data[MAX_DATA_SIZE], payload, receivers = 1, coding = CODING_4B5B, size = 16;
+	uint16_t baud = 1000, src_addr;
+	uint32_t seed = 1;
+	double drift = 0, gap = 0, last = 0, done = 0, drain;
+	int opt, packets = 1000, sent = 0, i, val;
+	
+	memset(&channel, 0, sizeof(channel));
+	channel.burst_len = 16;
+	channel.burst_ber = 0.5;
+	while ((opt = getopt(argc, argv, "b:c:l:n:g:r:e:u:U:E:d:D:j:s:")) != -1) {
+		switch (opt) {
+		case 'b': baud = atoi(optarg); break;
+		case 'c': coding = atoi(optarg); break;
+		case 'l': size = atoi(optarg); break;
+		case 'n': packets = atoi(optarg); break;
+		case 'g': gap = atof(optarg); break;
+		case 'r': receivers = atoi(optarg); break;
+		case 'e': channel.ber = atof(optarg); break;
+		case 'u': channel.burst_rate = atof(optarg); break;
+		case 'U': channel.burst_len = atof(optarg); break;
+		case 'E': channel.burst_ber = atof(optarg); break;
+		case 'd': drift = atof(optarg); break;
+		case 'D': channel.delay = atof(optarg); break;
+		case 'j': channel.jitter = atof(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (receivers < 1 || receivers > 2 || size < 2 || size > MAX_DATA_SIZE - 2 || coding >= CODINGS)
+		usage(argv[0]);
+	
+	/* the sender on timer 2, receivers on timers 1 and 0 */
+	sim_init(seed);
+	radio433_attach(&tx, 0, &txbuf, baud, TX, RADIO_TIMER2, &PORTC, PC2);
+	radio433_coding(&tx, coding);
+	radio433_addr(&tx, TX_ADDR);
+	sim_node(&tx, 0);
+	for (i = 0; i < receivers; i++) {
+		radio433_attach(&rx[i], &rxbuf[i], 0, baud, RX, i ? RADIO_TIMER0 : RADIO_TIMER1, &PORTC, PC3 + i);
+		radio433_addr(&rx[i], RX_ADDR);
+		sim_node(&rx[i], i ? -drift : drift);
+		sim_channel(&rx[i], &channel);
+	}
+	memset(result, 0, sizeof(result));
+	drain = DRAIN_BITS * 1000.0 / baud + (channel.delay + channel.jitter) / 1000.0 + 1;
+	
+	/* queue packets (as fast as the TX queue takes them, or one every
+	 * gap ms) and take the ones received, a millisecond at a time. the
+	 * run ends a little after the sender is done with the last frame,
+	 * however long frames take on the air */
+	while (!done || sim_time() < done + drain) {
+		if (sent < packets && sim_time() >= last + gap) {
+			fill(data, size, sent);
+			if (radio433_send(&tx, RX_ADDR, data, size) == ERR_OK) {
+				sent++;
+				last = sim_time();
+			}
+		}
+		if (sent == packets && !done) {
+			radio433_stats(&tx, &stats, 0);
+			if (stats.sent == (uint16_t)sent)
+				done = sim_time();
+		}
+		
+		sim_run(1);
+		
+		for (i = 0; i < receivers; i++) {
+			while ((val = radio433_recv(&rx[i], &src_addr, data, &payload)) != ERR_NO_DATA) {
+				if (val != ERR_OK)
+					result[i].errors++;
+				else if (src_addr == TX_ADDR && check(data, payload, size))
+					result[i].ok++;
+				else
+					result[i].bad++;
+			}
+		}
+	}
+	
+	printf("baud %d coding %d payload %d packets %d time %.1fs\n",
+		baud, coding, size, sent, done / 1000.0);
+	for (i = 0; i < receivers; i++) {
+		radio433_stats(&rx[i], &stats, 0);
+		printf("rx%d: ok %d per %.4f bad %d errors %d goodput %.1f bps | "
+			"syncs %d frames %d length %d frame %d crc %d overruns %d\n",
+			i, result[i].ok, 1.0 - (double)result[i].ok / sent, result[i].bad, result[i].errors,
+			result[i].ok * size * 8.0 / (done / 1000.0),
+			stats.syncs, stats.frames, stats.length_errors, stats.frame_errors,
+			stats.crc_errors, stats.overruns);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,17 @@
+/* radio channel from a sender to each receiver. bit periods are flipped
+ * at random (ber, or burst_ber inside a noise burst) and edges are late
+ * by delay, plus or minus jitter */
+struct sim_channel_s {
+	double ber;			// bit error rate
+	double burst_rate;		// chance of a noise burst starting, per bit
+	double burst_len;		// average noise burst length (bits)
+	double burst_ber;		// bit error rate inside a noise burst
+	double delay;			// propagation delay (us)
+	double jitter;			// propagation jitter, plus or minus (us)
+};
+
+void sim_init(uint32_t seed);
+int sim_node(struct radio_data_s *radio, double drift);
+int sim_channel(struct radio_data_s *radio, struct sim_channel_s *channel);
+void sim_run(double ms);
+double sim_time(void);
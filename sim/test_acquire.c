@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include <arq.h>
+#include <frag.h>
+#include "sim.h"
+
+/* test_acquire: a packet taken with radio433_acquire() stays in its RX
+ * slot until radio433_release(). meanwhile the other receive calls
+ * return ERR_BUSY, and the ARQ and fragmentation layers on the same
+ * radio give up polling instead of spinning (alarm() fails the test if
+ * one of them hangs). a second receiver gets the same packets through
+ * a handler (RADIO_CALLBACK), which acquires and releases them too */
+
+#define TX_ADDR			0x5150
+#define RX_ADDR			0x1234
+
+static struct radio_data_s tx, rx, cb;
+static struct radio_txbuf_s txbuf;
+static struct radio_rxbuf_s rxbuf[2];
+static int handled, mangled;
+
+static void fill(uint8_t *data, uint8_t size, uint8_t seq)
+{
+	uint8_t i;
+	
+	for (i = 0; i < size; i++)
+		data[i] = seq * 31 + i;
+}
+
+static void handler(struct radio_data_s *radio, uint16_t src_addr, uint8_t *data, uint8_t payload)
+{
+	uint8_t buf[MAX_DATA_SIZE];
+	
+	fill(buf, payload, handled);
+	if (src_addr != TX_ADDR || payload != 16 || memcmp(buf, data, payload))
+		mangled++;
+	handled++;
+}
+
+int main(void)
+{
+	static struct radio_arq_s arq;
+	static struct radio_frag_s frag;
+	uint8_t buf[FRAG_MAX_SIZE], data[MAX_DATA_SIZE], *ptr, payload;
+	uint16_t src_addr, size;
+	struct transport_s hdr;
+	int fail = 0, val;
+	
+	alarm(60);
+	sim_init(1);
+	radio433_attach(&tx, 0, &txbuf, 1000, TX, RADIO_TIMER2, &PORTC, PC2);
+	radio433_addr(&tx, TX_ADDR);
+	sim_node(&tx, 0);
+	radio433_attach(&rx, &rxbuf[0], 0, 1000, RX, RADIO_TIMER1, &PORTC, PC3);
+	radio433_addr(&rx, RX_ADDR);
+	sim_node(&rx, 0);
+	radio433_attach(&cb, &rxbuf[1], 0, 1000, RX, RADIO_TIMER0, &PORTC, PC4);
+	radio433_addr(&cb, RX_ADDR);
+	radio433_handler(&cb, handler);
+	sim_node(&cb, 0);
+	radio433_arq_init(&arq, &tx, &rx, TX_ADDR);
+	radio433_frag_init(&frag, &tx, &rx, TX_ADDR);
+	
+	/* the first packet is lent, the second one waits in the ring */
+	fill(data, 16, 0);
+	radio433_send(&tx, RX_ADDR, data, 16);
+	sim_run(500);
+	val = radio433_acquire(&rx, &src_addr, &ptr, &payload);
+	if (val != ERR_OK || src_addr != TX_ADDR || payload != 16 || memcmp(ptr, data, 16)) {
+		printf("acquire: %d\n", val);
+		fail = 1;
+	}
+	fill(data, 16, 1);
+	radio433_send(&tx, RX_ADDR, data, 16);
+	sim_run(500);
+	
+	if ((val = radio433_recv(&rx, &src_addr, data, &payload)) != ERR_BUSY ||
+	    (val = radio433_rx(&rx, data, &payload)) != ERR_BUSY ||
+	    (val = radio433_recvpkt(&rx, &hdr, data, &payload)) != ERR_BUSY ||
+	    (val = radio433_acquire(&rx, &src_addr, &ptr, &payload)) != ERR_BUSY) {
+		printf("receive while lent: %d\n", val);
+		fail = 1;
+	}
+	radio433_arq_poll(&arq);
+	if ((val = radio433_frag_recv(&frag, buf, &size)) != ERR_NO_DATA) {
+		printf("frag_recv while lent: %d\n", val);
+		fail = 1;
+	}
+	
+	/* the payload was not touched while lent */
+	fill(data, 16, 0);
+	if (memcmp(ptr, data, 16)) {
+		printf("lent slot overwritten\n");
+		fail = 1;
+	}
+	
+	radio433_release(&rx);
+	fill(buf, 16, 1);
+	val = radio433_recv(&rx, &src_addr, data, &payload);
+	if (val != ERR_OK || payload != 16 || memcmp(buf, data, 16)) {
+		printf("recv after release: %d\n", val);
+		fail = 1;
+	}
+	
+	if (handled != 2 || mangled) {
+		printf("handler: %d packets, %d bad\n", handled, mangled);
+		fail = 1;
+	}
+	
+	printf("test_acquire: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
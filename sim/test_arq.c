@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include <arq.h>
+#include "sim.h"
+
+/* test_arq: two half duplex nodes, A sends numbered frames to B over
+ * the ARQ. the link from A to B goes down while one frame is in flight,
+ * long enough for A to give it up after ARQ_RETRIES. B must skip that
+ * frame and deliver the ones sent after the link is back */
+
+#define A_ADDR			0x5150
+#define B_ADDR			0x1234
+#define FRAMES			6
+#define DEAD			2		// frame sent while the link is down
+
+static struct radio_data_s a, b;
+static struct radio_txbuf_s txbuf[2];
+static struct radio_rxbuf_s rxbuf[2];
+static struct radio_arq_s arqa, arqb;
+static uint8_t got[FRAMES];
+static int count, wrong;
+
+static void take(void)
+{
+	uint8_t data[MAX_DATA_SIZE], payload;
+	
+	while (radio433_arq_recv(&arqb, data, &payload) == ERR_OK) {
+		if (payload != 8 || data[0] >= FRAMES || data[1] != (uint8_t)(data[0] * 13))
+			wrong++;
+		else
+			got[count++ % FRAMES] = data[0];
+	}
+}
+
+static int send(uint8_t seq, int ms)
+{
+	uint8_t data[8];
+	
+	/* one frame at a time, until ACKed or given up */
+	memset(data, 0, sizeof(data));
+	data[0] = seq;
+	data[1] = seq * 13;
+	radio433_arq_send(&arqa, data, sizeof(data));
+	while (ms--) {
+		sim_run(1);
+		take();
+		if (!radio433_arq_poll(&arqa))
+			return 0;
+	}
+	
+	return 1;
+}
+
+int main(void)
+{
+	struct sim_channel_s up, down;
+	uint8_t i;
+	int fail = 0;
+	
+	memset(&up, 0, sizeof(up));
+	memset(&down, 0, sizeof(down));
+	down.ber = 0.5;
+	
+	sim_init(1);
+	radio433_attach(&a, &rxbuf[0], &txbuf[0], 1000, RX, RADIO_TIMER2, &PORTC, PC3);
+	radio433_halfduplex(&a, &PORTC, PC2);
+	radio433_addr(&a, A_ADDR);
+	sim_node(&a, 0);
+	sim_channel(&a, &up);
+	radio433_attach(&b, &rxbuf[1], &txbuf[1], 1000, RX, RADIO_TIMER1, &PORTC, PC4);
+	radio433_halfduplex(&b, &PORTC, PC5);
+	radio433_addr(&b, B_ADDR);
+	sim_node(&b, 0);
+	sim_channel(&b, &up);
+	radio433_arq_init(&arqa, &a, &a, B_ADDR);
+	radio433_arq_init(&arqb, &b, &b, A_ADDR);
+	
+	for (i = 0; i < FRAMES; i++) {
+		sim_channel(&b, i == DEAD ? &down : &up);
+		if (send(i, (ARQ_RETRIES + 2) * ARQ_TIMEOUT)) {
+			printf("frame %d still in flight\n", i);
+			fail = 1;
+		}
+	}
+	for (i = 0; i < 100; i++) {
+		sim_run(10);
+		take();
+	}
+	
+	/* all frames but the one given up, in order */
+	if (arqa.drops != 1 || arqb.lost != 1 || count != FRAMES - 1 || wrong) {
+		printf("drops %d lost %d delivered %d wrong %d\n", arqa.drops, arqb.lost, count, wrong);
+		fail = 1;
+	}
+	for (i = 0; i < count && i < FRAMES; i++) {
+		if (got[i] != (i < DEAD ? i : i + 1)) {
+			printf("frame %d delivered as %d\n", got[i], i);
+			fail = 1;
+		}
+	}
+	
+	printf("test_arq: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
@@ -0,0 +1,60 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include "sim.h"
+
+/* test_autobaud: a receiver following the rate of the sender keeps its
+ * time base in bit periods while it hunts between frames, so it runs
+ * along with the one of the sender and both see the same air time for
+ * each frame */
+
+#define FRAMES			6
+
+int main(void)
+{
+	static struct radio_data_s tx, rx;
+	static struct radio_txbuf_s txbuf;
+	static struct radio_rxbuf_s rxbuf;
+	struct radio_stamp_s txstamp, rxstamp;
+	uint8_t data[MAX_DATA_SIZE], payload, i;
+	uint16_t txair, rxair, ticks;
+	int fail = 0, frames = 0;
+	
+	sim_init(1);
+	radio433_attach(&tx, 0, &txbuf, 1000, TX, RADIO_TIMER2, &PORTC, PC2);
+	sim_node(&tx, 0);
+	radio433_attach(&rx, &rxbuf, 0, 1000, RX, RADIO_TIMER1, &PORTC, PC3);
+	radio433_autobaud(&rx);
+	sim_node(&rx, 0);
+	
+	for (i = 0; i < FRAMES; i++) {
+		memset(data, i, 10);
+		radio433_tx(&tx, data, 10);
+		sim_run(400);
+		
+		if (radio433_rx(&rx, data, &payload) != ERR_OK || payload != 10 || data[0] != i)
+			continue;
+		frames++;
+		radio433_txstamp(&tx, &txstamp);
+		radio433_rxstamp(&rx, &rxstamp);
+		txair = txstamp.end - txstamp.start;
+		rxair = rxstamp.end - rxstamp.start;
+		if (rxair > txair || txair - rxair > TSTROBE + TSYNC + 8) {
+			printf("frame %d: air time %d sent, %d received\n", i, txair, rxair);
+			fail = 1;
+		}
+	}
+	
+	/* both time bases count bit periods since attach */
+	ticks = radio433_ticks(&tx) - radio433_ticks(&rx);
+	if (frames != FRAMES || (int16_t)ticks > 20 || (int16_t)ticks < -20) {
+		printf("%d frames, time bases %d apart\n", frames, (int16_t)ticks);
+		fail = 1;
+	}
+	
+	printf("test_autobaud: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
@@ -0,0 +1,76 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include "sim.h"
+
+/* test_filter: packets to our address, a group we joined and broadcast
+ * are delivered, packets to other nodes are counted as filtered. built
+ * with RX_FILTER (dropped by the RX FSM, they never reach the ring) and
+ * without it (dropped by the receive calls) */
+
+#define TX_ADDR			0x5150
+#define RX_ADDR			0x1234
+#define GROUP_ADDR		0x7000
+#define OTHER_ADDR		0x4444
+
+static const uint16_t dst[] = {
+	RX_ADDR, OTHER_ADDR, GROUP_ADDR, OTHER_ADDR, BCAST_ADDR, OTHER_ADDR, RX_ADDR
+};
+
+#define PACKETS			(sizeof(dst) / sizeof(dst[0]))
+#define OTHERS			3
+
+int main(void)
+{
+	static struct radio_data_s tx, rx;
+	static struct radio_txbuf_s txbuf;
+	static struct radio_rxbuf_s rxbuf;
+	struct radio_stats_s stats;
+	uint8_t data[MAX_DATA_SIZE], payload, i, j;
+	uint16_t src_addr;
+	int fail = 0, ok = 0, val;
+	
+	sim_init(1);
+	radio433_attach(&tx, 0, &txbuf, 1000, TX, RADIO_TIMER2, &PORTC, PC2);
+	radio433_addr(&tx, TX_ADDR);
+	sim_node(&tx, 0);
+	radio433_attach(&rx, &rxbuf, 0, 1000, RX, RADIO_TIMER1, &PORTC, PC3);
+	radio433_addr(&rx, RX_ADDR);
+	radio433_join(&rx, GROUP_ADDR);
+	sim_node(&rx, 0);
+	
+	for (i = 0; i < PACKETS; i++) {
+		for (j = 0; j < 12; j++)
+			data[j] = i + j;
+		radio433_send(&tx, dst[i], data, 12);
+		sim_run(500);
+		
+		while ((val = radio433_recv(&rx, &src_addr, data, &payload)) != ERR_NO_DATA) {
+			if (val != ERR_OK || src_addr != TX_ADDR || payload != 12 || data[0] != i ||
+			    dst[i] == OTHER_ADDR) {
+				printf("packet %d to %04x: %d\n", i, dst[i], val);
+				fail = 1;
+			} else {
+				ok++;
+			}
+		}
+	}
+	
+	radio433_stats(&rx, &stats, 0);
+	if (ok != PACKETS - OTHERS || stats.filtered != OTHERS || stats.crc_errors) {
+		printf("delivered %d filtered %d crc %d\n", ok, stats.filtered, stats.crc_errors);
+		fail = 1;
+	}
+#if RX_FILTER == 1
+	if (stats.frames != ok) {
+		printf("%d frames in the ring for %d packets\n", stats.frames, ok);
+		fail = 1;
+	}
+#endif
+	
+	printf("test_filter (RX_FILTER %d): %s\n", RX_FILTER, fail ? "FAIL" : "ok");
+	
+	return fail;
+}
@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include <arq.h>
+#include <frag.h>
+#include "sim.h"
+
+/* test_frag: fragments that do not fit the reassembly buffer (past
+ * FRAG_MAX_SIZE, or an index past the fragment count) are dropped, and
+ * a message sent after them still arrives */
+
+#define TX_ADDR			0x5150
+#define RX_ADDR			0x1234
+
+struct rxbuf_s {
+	uint8_t data[FRAG_MAX_SIZE];
+	uint8_t guard[MAX_DATA_SIZE];
+};
+
+static struct radio_data_s tx, rx;
+static struct radio_txbuf_s txbuf;
+static struct radio_rxbuf_s rxbuf;
+static struct radio_frag_s txfrag, rxfrag;
+static struct rxbuf_s buf;
+
+static int recv(int ms, uint16_t *size)
+{
+	int val;
+	
+	/* the first message (or error) taken in ms */
+	while (ms--) {
+		sim_run(1);
+		if ((val = radio433_frag_recv(&rxfrag, buf.data, size)) != ERR_NO_DATA)
+			return val;
+	}
+	
+	return ERR_NO_DATA;
+}
+
+static int bad(uint8_t index, uint8_t frags, uint8_t size)
+{
+	uint8_t data[MAX_DATA_SIZE];
+	uint16_t rxsize;
+	int val;
+	
+	/* a fragment made up by hand, sent as a plain packet */
+	memset(data, 0xaa, sizeof(data));
+	data[0] = index + 0x80;
+	data[1] = index;
+	data[2] = frags;
+	radio433_send(&tx, RX_ADDR, data, size + FRAG_HEADER_SIZE);
+	
+	val = recv(500, &rxsize);
+	if (val != ERR_NO_DATA || rxfrag.rxstate != FRAG_IDLE) {
+		printf("fragment %d of %d (%d bytes) taken: %d\n", index, frags, size, val);
+		return 1;
+	}
+	
+	return 0;
+}
+
+int main(void)
+{
+	uint8_t msg[300];
+	uint16_t size, i;
+	int fail = 0, val;
+	
+	sim_init(1);
+	radio433_attach(&tx, 0, &txbuf, 1000, TX, RADIO_TIMER2, &PORTC, PC2);
+	radio433_addr(&tx, TX_ADDR);
+	sim_node(&tx, 0);
+	radio433_attach(&rx, &rxbuf, 0, 1000, RX, RADIO_TIMER1, &PORTC, PC3);
+	radio433_addr(&rx, RX_ADDR);
+	sim_node(&rx, 0);
+	
+	/* one way link, both ends only use tx or rx */
+	radio433_frag_init(&txfrag, &tx, &tx, RX_ADDR);
+	radio433_frag_init(&rxfrag, &tx, &rx, TX_ADDR);
+	memset(buf.guard, 0x55, sizeof(buf.guard));
+	
+	/* the last of FRAG_MAX_FRAGS fragments, full: 522 bytes */
+	fail |= bad(FRAG_MAX_FRAGS - 1, FRAG_MAX_FRAGS, FRAG_DATA_SIZE);
+	fail |= bad(FRAG_MAX_FRAGS - 1, FRAG_MAX_FRAGS, FRAG_MAX_SIZE - (FRAG_MAX_FRAGS - 1) * FRAG_DATA_SIZE + 1);
+	/* index past the count, and past FRAG_MAX_FRAGS */
+	fail |= bad(2, 2, 10);
+	fail |= bad(FRAG_MAX_FRAGS, FRAG_MAX_FRAGS + 1, 10);
+	
+	for (i = 0; i < sizeof(buf.guard); i++) {
+		if (buf.guard[i] != 0x55) {
+			printf("reassembly buffer overflow\n");
+			fail = 1;
+			break;
+		}
+	}
+	
+	/* a real message still goes through */
+	for (i = 0; i < sizeof(msg); i++)
+		msg[i] = i * 7;
+	radio433_frag_send(&txfrag, msg, sizeof(msg));
+	for (i = 0, val = ERR_NO_DATA; i < 10000 && val == ERR_NO_DATA; i++) {
+		radio433_frag_poll(&txfrag);
+		val = recv(1, &size);
+	}
+	if (val != ERR_OK || size != sizeof(msg) || memcmp(buf.data, msg, size)) {
+		printf("message lost: %d, %d bytes\n", val, size);
+		fail = 1;
+	}
+	
+	printf("test_frag: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include "sim.h"
+
+/* test_reply: two half duplex nodes, A sends a control frame every
+ * 500ms and B takes each one some time later, arming a reply for the
+ * next one with radio433_reply(). however late B gets to it, each reply
+ * must start the same number of bit periods after the frame it answers.
+ * a control frame garbled after its sync doesn't release the reply, and
+ * with no control frames at all it still goes after TREPLY */
+
+#define FRAMES			8
+
+#define NOISE_BER		0.08		// on the garbled control frames
+
+static uint16_t sent(struct radio_data_s *radio)
+{
+	struct radio_stats_s stats;
+	
+	radio433_stats(radio, &stats, 0);
+	
+	return stats.sent;
+}
+
+int main(void)
+{
+	static struct radio_data_s a, b;
+	static struct radio_txbuf_s txbuf[2];
+	static struct radio_rxbuf_s rxbuf[2];
+	struct radio_stamp_s rxstamp, txstamp;
+	uint8_t data[MAX_DATA_SIZE], payload, i;
+	struct sim_channel_s noise;
+	struct radio_stats_s before, after;
+	uint16_t gap = 0, count;
+	int fail = 0, delay, replies = 0, val;
+	
+	sim_init(1);
+	radio433_attach(&a, &rxbuf[0], &txbuf[0], 1000, RX, RADIO_TIMER2, &PORTC, PC3);
+	radio433_halfduplex(&a, &PORTC, PC2);
+	sim_node(&a, 0);
+	radio433_attach(&b, &rxbuf[1], &txbuf[1], 1000, RX, RADIO_TIMER1, &PORTC, PC4);
+	radio433_halfduplex(&b, &PORTC, PC5);
+	sim_node(&b, 0);
+	
+	for (i = 0; i < FRAMES; i++) {
+		memset(data, i, 5);
+		radio433_txprio(&a, data, 5, PRIO_HIGH);
+		
+		/* B polls late, a different time for each frame */
+		delay = 150 + (i * 37) % 100;
+		sim_run(delay);
+		val = radio433_rx(&b, data, &payload);
+		if (val != ERR_OK || payload != 5 || data[0] != i) {
+			printf("control frame %d: %d\n", i, val);
+			fail = 1;
+		}
+		radio433_rxstamp(&b, &rxstamp);
+		
+		memset(data, 0x80 + i, 3);
+		if (radio433_reply(&b, data, 3) != ERR_OK) {
+			printf("reply %d not armed\n", i);
+			fail = 1;
+		}
+		sim_run(500 - delay);
+		
+		/* the reply armed with the last frame went after this one */
+		if (i) {
+			radio433_txstamp(&b, &txstamp);
+			if (i == 1)
+				gap = txstamp.start - rxstamp.end;
+			if ((uint16_t)(txstamp.start - rxstamp.end) != gap || gap > 2 * TTURN) {
+				printf("reply %d: %d bit periods after the frame\n", i - 1,
+				 (uint16_t)(txstamp.start - rxstamp.end));
+				fail = 1;
+			}
+		}
+		
+		while (radio433_rx(&a, data, &payload) == ERR_OK)
+			if (payload == 3 && data[0] == 0x80 + i - 1)
+				replies++;
+	}
+	
+	if (replies != FRAMES - 1) {
+		printf("%d replies\n", replies);
+		fail = 1;
+	}
+	
+	/* the last reply is still armed. control frames that B syncs to
+	 * but gets with a bad length word (the ERROR state, as after a false
+	 * sync on noise) or bad data words must not release it. they are
+	 * sent over a noisy channel until both kinds showed up (TREPLY is
+	 * set long enough for that in the Makefile) */
+	memset(&noise, 0, sizeof(noise));
+	count = sent(&b);
+	radio433_stats(&b, &before, 0);
+	for (i = 0; i < 40; i++) {
+		radio433_stats(&b, &after, 0);
+		if (after.length_errors != before.length_errors && after.frame_errors != before.frame_errors)
+			break;
+		noise.ber = NOISE_BER;
+		sim_channel(&b, &noise);
+		memset(data, FRAMES, 5);
+		radio433_txprio(&a, data, 5, PRIO_HIGH);
+		sim_run(250);
+		noise.ber = 0;
+		sim_channel(&b, &noise);
+		while (radio433_rx(&b, data, &payload) != ERR_NO_DATA);
+	}
+	if (i == 40 || after.frames != before.frames || sent(&b) != count) {
+		printf("garbled frames: %d length errors, %d frame errors, %d frames, %d replies sent\n",
+		 after.length_errors - before.length_errors, after.frame_errors - before.frame_errors,
+		 after.frames - before.frames, sent(&b) - count);
+		fail = 1;
+	}
+	
+	/* the next good one does */
+	memset(data, FRAMES + 1, 5);
+	radio433_txprio(&a, data, 5, PRIO_HIGH);
+	sim_run(500);
+	radio433_rx(&b, data, &payload);
+	radio433_rxstamp(&b, &rxstamp);
+	radio433_txstamp(&b, &txstamp);
+	if (sent(&b) != count + 1 || (uint16_t)(txstamp.start - rxstamp.end) != gap) {
+		printf("reply after the garbled frame: %d sent, %d bit periods after the frame\n",
+		 sent(&b) - count, (uint16_t)(txstamp.start - rxstamp.end));
+		fail = 1;
+	}
+	
+	/* no control frames: the reply waits TREPLY bit periods, then goes */
+	count = sent(&b);
+	radio433_reply(&b, data, 3);
+	sim_run(TREPLY - 100);
+	if (sent(&b) != count) {
+		printf("reply sent with no control frame\n");
+		fail = 1;
+	}
+	sim_run(500);
+	if (sent(&b) != count + 1) {
+		printf("reply still held after TREPLY\n");
+		fail = 1;
+	}
+	
+	printf("test_reply: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
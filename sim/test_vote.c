@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <radio433.h>
+#include "sim.h"
+
+/* test_vote: two receivers on a clean channel, built with RX_SAMPLES 5.
+ * the bursts of samples busy wait inside the timer ISR of each one, so
+ * the other receiver runs its ISRs meanwhile. both must get every packet */
+
+#define TX_ADDR			0x5150
+#define RX_ADDR			0x1234
+#define BAUD			5000
+#define PACKETS			20
+
+int main(void)
+{
+	static struct radio_data_s tx, rx[2];
+	static struct radio_txbuf_s txbuf;
+	static struct radio_rxbuf_s rxbuf[2];
+	uint8_t data[MAX_DATA_SIZE], payload, i, j;
+	uint16_t src_addr;
+	int fail = 0, ok[2] = {0, 0}, val;
+	
+	sim_init(1);
+	radio433_attach(&tx, 0, &txbuf, BAUD, TX, RADIO_TIMER2, &PORTC, PC2);
+	radio433_addr(&tx, TX_ADDR);
+	sim_node(&tx, 0);
+	radio433_attach(&rx[0], &rxbuf[0], 0, BAUD, RX, RADIO_TIMER1, &PORTC, PC3);
+	radio433_addr(&rx[0], RX_ADDR);
+	sim_node(&rx[0], 0);
+	radio433_attach(&rx[1], &rxbuf[1], 0, BAUD, RX, RADIO_TIMER0, &PORTC, PC4);
+	radio433_addr(&rx[1], RX_ADDR);
+	sim_node(&rx[1], 0);
+	
+	for (i = 0; i < PACKETS; i++) {
+		for (j = 0; j < 16; j++)
+			data[j] = i + j;
+		radio433_send(&tx, RX_ADDR, data, 16);
+		sim_run(200);
+		
+		for (j = 0; j < 2; j++) {
+			while ((val = radio433_recv(&rx[j], &src_addr, data, &payload)) != ERR_NO_DATA) {
+				if (val != ERR_OK || src_addr != TX_ADDR || payload != 16 || data[0] != i) {
+					printf("rx%d packet %d: %d\n", j, i, val);
+					fail = 1;
+					break;
+				}
+				ok[j]++;
+			}
+		}
+	}
+	
+	if (ok[0] != PACKETS || ok[1] != PACKETS) {
+		printf("delivered %d and %d of %d\n", ok[0], ok[1], PACKETS);
+		fail = 1;
+	}
+	
+	printf("test_vote: %s\n", fail ? "FAIL" : "ok");
+	
+	return fail;
+}
@@ -0,0 +1,4 @@
+/* host build: delays are not used by the radio433 sources */
+
+#define _delay_ms(ms)
+#define _delay_us(us)